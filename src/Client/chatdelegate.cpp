@@ -0,0 +1,109 @@
+#include <QApplication>
+#include <QPainter>
+#include <QTextLayout>
+#include <QtMath>
+#include "chatdelegate.h"
+#include "chatmodel.h"
+
+ChatDelegate::ChatDelegate(QAbstractItemView* view) : QStyledItemDelegate(view), view(view) {}
+
+int ChatDelegate::bodyWidth() const
+{
+    return qMax(view->viewport()->width() * bodyWidthRatio / 100 - 2 * margin, 1);
+}
+
+QString ChatDelegate::bodyText(const QModelIndex& index)
+{
+    const QString text = index.data(Qt::DisplayRole).toString();
+    const QString time = index.data(ChatModel::TimeRole).toString();
+    if (time.isEmpty()) {
+        return text;
+    }
+    return text + QString(" (") + time + QString(")");
+}
+
+QFont ChatDelegate::senderFont(const QFont& font)
+{
+    QFont boldFont = font;
+    boldFont.setBold(true);
+    return boldFont;
+}
+
+QSize ChatDelegate::textSize(const QString& text, const QFont& font, const int width)
+{
+    QTextOption textOption;
+    textOption.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+
+    QTextLayout layout(text, font);
+    layout.setTextOption(textOption);
+    layout.beginLayout();
+    qreal height    = 0;
+    qreal usedWidth = 0;
+    while (true) {
+        QTextLine line = layout.createLine();
+        if (!line.isValid()) {
+            break;
+        }
+        line.setLineWidth(width);
+        line.setPosition(QPointF(0, height));
+        height += line.height();
+        usedWidth = qMax(usedWidth, line.naturalTextWidth());
+    }
+    layout.endLayout();
+    return {qCeil(usedWidth), qCeil(height)};
+}
+
+QSize ChatDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+    const auto kind = static_cast<ChatEntry::Kind>(index.data(ChatModel::KindRole).toInt());
+    if (kind == ChatEntry::Kind::Event) {
+        return {option.rect.width(), QFontMetrics(option.font).height() + 2 * margin};
+    }
+    int height = textSize(bodyText(index), option.font, bodyWidth()).height() + 2 * margin;
+    if (index.data(ChatModel::ShowSenderRole).toBool()) {
+        height += QFontMetrics(senderFont(option.font)).height();
+    }
+    return {option.rect.width(), height};
+}
+
+void ChatDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+    QStyleOptionViewItem background = option;
+    initStyleOption(&background, index);
+    background.text.clear();
+    const QWidget* widget = option.widget;
+    QStyle* style         = widget != nullptr ? widget->style() : QApplication::style();
+    style->drawPrimitive(QStyle::PE_PanelItemViewItem, &background, painter, widget);
+
+    painter->save();
+    const QRect content = option.rect.adjusted(margin, margin, -margin, -margin);
+    const auto kind     = static_cast<ChatEntry::Kind>(index.data(ChatModel::KindRole).toInt());
+    if (kind == ChatEntry::Kind::Event) {
+        painter->setPen(Qt::gray);
+        painter->setFont(option.font);
+        painter->drawText(content, Qt::AlignCenter, index.data(Qt::DisplayRole).toString());
+        painter->restore();
+        return;
+    }
+
+    int top = content.top();
+    if (index.data(ChatModel::ShowSenderRole).toBool()) {
+        const QFont boldFont = senderFont(option.font);
+        painter->setFont(boldFont);
+        const int senderHeight = QFontMetrics(boldFont).height();
+        painter->drawText(QRect(content.left(), top, content.width(), senderHeight),
+                          Qt::AlignLeft | Qt::AlignVCenter, index.data(ChatModel::SenderRole).toString());
+        top += senderHeight;
+    }
+
+    const bool outgoing = kind == ChatEntry::Kind::Outgoing;
+    const QString body  = bodyText(index);
+    const QSize size    = textSize(body, option.font, bodyWidth());
+    const int left      = outgoing ? content.right() - size.width() : content.left();
+
+    QTextOption textOption(outgoing ? Qt::AlignRight : Qt::AlignLeft);
+    textOption.setWrapMode(QTextOption::WrapAtWordBoundaryOrAnywhere);
+    painter->setFont(option.font);
+    painter->drawText(QRectF(left, top, size.width() + 1, size.height()), body, textOption);
+    painter->restore();
+}
@@ -0,0 +1,28 @@
+#ifndef CHAT_DELEGATE_H
+#define CHAT_DELEGATE_H
+
+#include <QStyledItemDelegate>
+#include <QAbstractItemView>
+
+class ChatDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(ChatDelegate)
+public:
+    explicit ChatDelegate(QAbstractItemView* view);
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+    [[nodiscard]] QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+
+private:
+    [[nodiscard]] int bodyWidth() const;
+    static QString bodyText(const QModelIndex& index);
+    static QSize textSize(const QString& text, const QFont& font, int width);
+    static QFont senderFont(const QFont& font);
+
+private:
+    QAbstractItemView* view;
+    static constexpr int margin         = 4;
+    static constexpr int bodyWidthRatio = 70; // percent of the viewport
+};
+
+#endif // CHAT_DELEGATE_H
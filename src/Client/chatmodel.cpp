@@ -0,0 +1,147 @@
+#include "chatmodel.h"
+
+ChatModel::ChatModel(QObject* parent) : QAbstractListModel(parent), firstVisible(0) {}
+
+int ChatModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return entries.size() - firstVisible;
+}
+
+QVariant ChatModel::data(const QModelIndex& index, const int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount()) {
+        return {};
+    }
+    const ChatEntry& chatEntry = entries.at(firstVisible + index.row());
+    switch (role) {
+        case Qt::DisplayRole:
+            return chatEntry.attachment.isEmpty() ? chatEntry.text : attachmentText(chatEntry);
+        case SenderRole:
+            return chatEntry.sender;
+        case TimeRole:
+            return chatEntry.time;
+        case KindRole:
+            return static_cast<int>(chatEntry.kind);
+        case ShowSenderRole:
+            return chatEntry.showSender;
+        default:
+            return {};
+    }
+}
+
+QString ChatModel::attachmentText(const ChatEntry& chatEntry)
+{
+    const qint64 size = chatEntry.attachmentSize;
+    QString readableSize;
+    if (size < 1024) {
+        readableSize = tr("%1 B").arg(size);
+    } else if (size < 1024 * 1024) {
+        readableSize = tr("%1 KB").arg(static_cast<double>(size) / 1024, 0, 'f', 1);
+    } else {
+        readableSize = tr("%1 MB").arg(static_cast<double>(size) / (1024 * 1024), 0, 'f', 1);
+    }
+    return tr("file %1, %2 - double click to save").arg(chatEntry.text, readableSize);
+}
+
+const ChatEntry& ChatModel::entry(const int row) const
+{
+    return entries.at(firstVisible + row);
+}
+
+ChatEntry ChatModel::makeEntry(const Message& message, const QString& selfName)
+{
+    ChatEntry chatEntry;
+    chatEntry.sender         = message.getSender();
+    chatEntry.text           = message.getMessage().toString();
+    chatEntry.attachment     = message.getAttachment().toString();
+    chatEntry.attachmentSize = message.getAttachmentSize();
+    // the server stamp is shown in local time, older messages keep the sender's clock
+    chatEntry.time = message.getTime();
+    if (message.getSender() == selfName) {
+        chatEntry.kind = ChatEntry::Kind::Outgoing;
+        lastSender.clear();
+    } else {
+        chatEntry.kind       = ChatEntry::Kind::Incoming;
+        chatEntry.showSender = lastSender != message.getSender();
+        lastSender           = message.getSender();
+    }
+    return chatEntry;
+}
+
+void ChatModel::append(const QVector<ChatEntry>& newEntries)
+{
+    if (newEntries.isEmpty()) {
+        return;
+    }
+    const int first = rowCount();
+    beginInsertRows(QModelIndex(), first, first + newEntries.size() - 1);
+    entries += newEntries;
+    endInsertRows();
+}
+
+void ChatModel::appendMessage(const Message& message, const QString& selfName)
+{
+    append({makeEntry(message, selfName)});
+}
+
+void ChatModel::appendMessages(const QList<Message>& messages, const QString& selfName)
+{
+    QVector<ChatEntry> newEntries;
+    newEntries.reserve(messages.size());
+    for (const auto& message : messages) {
+        newEntries.append(makeEntry(message, selfName));
+    }
+    append(newEntries);
+}
+
+void ChatModel::appendEvent(const QString& text)
+{
+    ChatEntry chatEntry;
+    chatEntry.kind = ChatEntry::Kind::Event;
+    chatEntry.text = text;
+    lastSender.clear();
+    append({chatEntry});
+}
+
+void ChatModel::setHistory(const QList<Message>& messages, const QString& selfName, const int visibleCount)
+{
+    beginResetModel();
+    entries.clear();
+    lastSender.clear();
+    entries.reserve(messages.size());
+    for (const auto& message : messages) {
+        entries.append(makeEntry(message, selfName));
+    }
+    firstVisible = qMax(entries.size() - visibleCount, 0);
+    endResetModel();
+}
+
+bool ChatModel::canLoadOlder() const
+{
+    return firstVisible > 0;
+}
+
+int ChatModel::loadOlder(const int count)
+{
+    const int loaded = qMin(count, firstVisible);
+    if (loaded <= 0) {
+        return 0;
+    }
+    beginInsertRows(QModelIndex(), 0, loaded - 1);
+    firstVisible -= loaded;
+    endInsertRows();
+    return loaded;
+}
+
+void ChatModel::clear()
+{
+    beginResetModel();
+    entries.clear();
+    entries.squeeze();
+    firstVisible = 0;
+    lastSender.clear();
+    endResetModel();
+}
@@ -0,0 +1,63 @@
+#ifndef CHAT_MODEL_H
+#define CHAT_MODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+#include "message.h"
+
+struct ChatEntry {
+    enum class Kind : quint8
+    {
+        Incoming,
+        Outgoing,
+        Event
+    };
+    Kind kind       = Kind::Event;
+    bool showSender = false;
+    QString sender;
+    QString text;
+    QString time;
+    QString attachment; // hex sha-256 of the file named by text, empty for plain messages
+    qint64 attachmentSize = 0;
+};
+
+/* one row per message, wrapping and alignment are done by ChatDelegate at paint time,
+ * history is materialized at once but exposed to the view page by page from the bottom */
+class ChatModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(ChatModel)
+public:
+    enum Role
+    {
+        SenderRole = Qt::UserRole + 1,
+        TimeRole,
+        KindRole,
+        ShowSenderRole
+    };
+
+    explicit ChatModel(QObject* parent = nullptr);
+    [[nodiscard]] int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    [[nodiscard]] QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    [[nodiscard]] const ChatEntry& entry(int row) const;
+
+    void appendMessage(const Message& message, const QString& selfName);
+    void appendMessages(const QList<Message>& messages, const QString& selfName);
+    void appendEvent(const QString& text);
+    void setHistory(const QList<Message>& messages, const QString& selfName, int visibleCount);
+    [[nodiscard]] bool canLoadOlder() const;
+    int loadOlder(int count);
+    void clear();
+
+private:
+    ChatEntry makeEntry(const Message& message, const QString& selfName);
+    static QString attachmentText(const ChatEntry& chatEntry);
+    void append(const QVector<ChatEntry>& newEntries);
+
+private:
+    QVector<ChatEntry> entries;
+    int firstVisible;
+    QString lastSender;
+};
+
+#endif // CHAT_MODEL_H
@@ -0,0 +1,487 @@
+#include <QDataStream>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QJsonArray>
+#include <QFile>
+#include <QHostAddress>
+#include <QFileInfo>
+#include <algorithm>
+#include "clientconnection.h"
+#include "constants.h"
+#include "filechunk.h"
+
+ClientConnection::ClientConnection(QObject* parent)
+    : QObject(parent), clientSocket(new QSslSocket(this)), flushTimer(new QTimer(this))
+{
+#ifdef SSL_ENABLE
+    clientSocket->setProtocol(QSsl::SslV3);
+    QByteArray certificate;
+    QFile fileCertificate("ssl/ssl.cert");
+    if (fileCertificate.open(QIODevice::ReadOnly)) {
+        certificate = fileCertificate.readAll();
+        fileCertificate.close();
+    } else {
+        qWarning() << fileCertificate.errorString();
+    }
+    QSslCertificate sslCertificate(certificate);
+    clientSocket->setLocalCertificate(sslCertificate);
+#endif
+
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(flushInterval);
+    connect(flushTimer, &QTimer::timeout, this, &ClientConnection::flushMessages);
+
+    connect(clientSocket, &QSslSocket::connected, this, &ClientConnection::connectedSig);
+    connect(clientSocket, &QSslSocket::disconnected, this, &ClientConnection::disconnectedSig);
+    connect(clientSocket, &QSslSocket::readyRead, this, &ClientConnection::onReadyRead);
+    connect(clientSocket, &QSslSocket::bytesWritten, this, &ClientConnection::sendChunks);
+    connect(clientSocket, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error), this,
+            &ClientConnection::onError);
+}
+
+ClientConnection::~ClientConnection()
+{
+    delete clientSocket;
+}
+
+void ClientConnection::connectToServer(const QString& host, const quint16 port)
+{
+    clientSocket->connectToHost(QHostAddress(host), port);
+#ifdef SSL_ENABLE
+    clientSocket->startClientEncryption();
+#endif
+}
+
+void ClientConnection::sendPacket(const QJsonObject& packet)
+{
+    if (clientSocket->state() != QAbstractSocket::ConnectedState) {
+        return;
+    }
+    QDataStream clientStream(clientSocket);
+    clientStream.setVersion(SERIALIZER_VERSION);
+    clientStream << QJsonDocument(packet).toJson(QJsonDocument::Compact);
+}
+
+/* render cached history right away and ask the server only for newer messages */
+void ClientConnection::joinGroup(QJsonObject packet, const QString& server, const QString& epoch,
+                                 const QString& userName)
+{
+    selfName                = userName;
+    const QString groupName = packet[Packet::Data::GROUP_NAME].toString();
+    auto& cache             = caches[groupName];
+    cache                   = std::make_unique<MessageCache>(server, groupName, epoch);
+
+    const QList<Message> cached = cache->load();
+    cachedMessages.insert(groupName, cached);
+    packet[Packet::Data::LAST_ID] = static_cast<double>(cache->getLastId());
+    emit historyLoadedSig(groupName, cached);
+    sendPacket(packet);
+}
+
+void ClientConnection::leaveGroup(const QJsonObject& packet)
+{
+    const QString groupName = packet[Packet::Data::GROUP_NAME].toString();
+    caches.erase(groupName);
+    cachedMessages.remove(groupName);
+    sendPacket(packet);
+}
+
+void ClientConnection::disconnectFromHost()
+{
+    dropTransfers();
+    clientSocket->disconnectFromHost();
+}
+
+void ClientConnection::abort()
+{
+    pendingMessages.clear();
+    flushTimer->stop();
+    dropTransfers();
+    clientSocket->abort();
+}
+
+/* transfers do not survive the connection, the server drops its side as well */
+void ClientConnection::dropTransfers()
+{
+    for (const auto& upload : uploads) {
+        emit uploadFailedSig(upload->groupName, QFileInfo(upload->file).fileName(), tr("connection lost"));
+    }
+    uploads.clear();
+    while (!downloads.empty()) {
+        finishDownload(downloads.begin()->first, false);
+    }
+}
+
+void ClientConnection::uploadFile(const QString& groupName, const QString& path)
+{
+    auto upload       = std::make_unique<Upload>();
+    upload->id        = ++lastUploadId;
+    upload->groupName = groupName;
+    upload->file.setFileName(path);
+    if (!upload->file.open(QIODevice::ReadOnly) || upload->file.size() == 0) {
+        emit uploadFailedSig(groupName, QFileInfo(path).fileName(), tr("unable to read the file"));
+        return;
+    }
+    upload->size           = upload->file.size();
+    const quint64 uploadId = upload->id;
+    uploads.push_back(std::move(upload));
+    hashUpload(uploadId);
+}
+
+/* a slice per event loop pass, packets keep flowing while a large file is hashed */
+void ClientConnection::hashUpload(const quint64 uploadId)
+{
+    const auto found = std::find_if(uploads.begin(), uploads.end(), [uploadId](const std::unique_ptr<Upload>& upload) {
+        return upload->id == uploadId;
+    });
+    if (found == uploads.end()) {
+        return;
+    }
+    Upload& upload         = **found;
+    const QByteArray slice = upload.file.read(hashSlice);
+    if (slice.isEmpty() && !upload.file.atEnd()) {
+        emit uploadFailedSig(upload.groupName, QFileInfo(upload.file).fileName(), tr("unable to read the file"));
+        uploads.erase(found);
+        return;
+    }
+    upload.hasher.addData(slice);
+    if (!upload.file.atEnd()) {
+        QTimer::singleShot(0, this, [this, uploadId] { hashUpload(uploadId); });
+        return;
+    }
+
+    upload.hash = upload.hasher.result();
+    QJsonObject packet;
+    packet[Packet::Type::TYPE]       = Packet::Type::FILE_OFFER;
+    packet[Packet::Data::GROUP_NAME] = upload.groupName;
+    packet[Packet::Data::FILE_NAME]  = QFileInfo(upload.file).fileName();
+    packet[Packet::Data::FILE_SIZE]  = static_cast<double>(upload.size);
+    packet[Packet::Data::FILE_HASH]  = QString::fromLatin1(upload.hash.toHex());
+    sendPacket(packet);
+}
+
+void ClientConnection::handleFileOfferPacket(const QJsonObject& packet)
+{
+    const QString hexHash = packet.value(QLatin1String(Packet::Data::FILE_HASH)).toString();
+    const QByteArray hash = QByteArray::fromHex(hexHash.toLatin1());
+    const auto found =
+        std::find_if(uploads.begin(), uploads.end(), [&hash](const std::unique_ptr<Upload>& upload) {
+            return upload->offset < 0 && upload->hash == hash;
+        });
+    if (!packet.value(QLatin1String(Packet::Data::SUCCESS)).toBool()) {
+        // also the answer to an upload that was sent completely but did not check out
+        if (found != uploads.end()) {
+            uploads.erase(found);
+        }
+        emit uploadFailedSig(packet.value(QLatin1String(Packet::Data::GROUP_NAME)).toString(),
+                             packet.value(QLatin1String(Packet::Data::FILE_NAME)).toString(),
+                             packet.value(QLatin1String(Packet::Data::REASON)).toString());
+        return;
+    }
+    if (found == uploads.end()) {
+        return;
+    }
+    // the server already has the content when it asks for nothing
+    const qint64 offset = static_cast<qint64>(packet.value(QLatin1String(Packet::Data::OFFSET)).toDouble(0));
+    if (offset >= (*found)->size || !(*found)->file.seek(offset)) {
+        uploads.erase(found);
+        return;
+    }
+    (*found)->offset = offset;
+    sendChunks();
+}
+
+/* a chunk goes out only while little is queued, so chat packets never wait behind a whole file */
+void ClientConnection::sendChunks()
+{
+    while (clientSocket->state() == QAbstractSocket::ConnectedState &&
+           clientSocket->bytesToWrite() < FileChunk::SEND_WINDOW) {
+        const auto next = std::find_if(uploads.begin(), uploads.end(),
+                                       [](const std::unique_ptr<Upload>& upload) { return upload->offset >= 0; });
+        if (next == uploads.end()) {
+            return;
+        }
+        std::unique_ptr<Upload> upload = std::move(*next);
+        uploads.erase(next);
+        const QByteArray data = upload->file.read(FileChunk::DATA_SIZE);
+        if (data.isEmpty()) {
+            emit uploadFailedSig(upload->groupName, QFileInfo(upload->file).fileName(), tr("unable to read the file"));
+            continue;
+        }
+        clientSocket->write(FileChunk::frameHeader(upload->hash, upload->offset, data.size()));
+        clientSocket->write(data);
+        upload->offset += data.size();
+        // the server answers a complete upload with the message or an error
+        if (upload->offset < upload->size) {
+            uploads.push_back(std::move(upload));
+        }
+    }
+}
+
+void ClientConnection::downloadFile(const QString& groupName, const QString& hash, const QString& path)
+{
+    const QByteArray rawHash = QByteArray::fromHex(hash.toLatin1());
+    if (rawHash.size() != FileChunk::HASH_SIZE || downloads.count(rawHash) != 0) {
+        emit downloadFinishedSig(groupName, path, false);
+        return;
+    }
+    auto download       = std::make_unique<Download>();
+    download->groupName = groupName;
+    download->path      = path;
+    download->file.setFileName(path + QString(".part"));
+    if (!download->file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        emit downloadFinishedSig(groupName, path, false);
+        return;
+    }
+    downloads[rawHash] = std::move(download);
+
+    QJsonObject packet;
+    packet[Packet::Type::TYPE]       = Packet::Type::FILE_DOWNLOAD;
+    packet[Packet::Data::GROUP_NAME] = groupName;
+    packet[Packet::Data::FILE_HASH]  = hash;
+    sendPacket(packet);
+}
+
+void ClientConnection::handleFileDownloadPacket(const QJsonObject& packet)
+{
+    const QString hexHash = packet.value(QLatin1String(Packet::Data::FILE_HASH)).toString();
+    const QByteArray hash = QByteArray::fromHex(hexHash.toLatin1());
+    const auto found      = downloads.find(hash);
+    if (found == downloads.end()) {
+        return;
+    }
+    found->second->size = static_cast<qint64>(packet.value(QLatin1String(Packet::Data::FILE_SIZE)).toDouble(-1));
+    if (!packet.value(QLatin1String(Packet::Data::SUCCESS)).toBool() || found->second->size <= 0) {
+        finishDownload(hash, false);
+    }
+}
+
+void ClientConnection::receiveChunk(const QByteArray& frame)
+{
+    QByteArray hash;
+    qint64 offset = 0;
+    QByteArray data;
+    if (!FileChunk::parse(frame, hash, offset, data)) {
+        return;
+    }
+    const auto found = downloads.find(hash);
+    if (found == downloads.end()) {
+        return;
+    }
+    Download& download = *found->second;
+    if (download.size < 0 || offset != download.received || offset + data.size() > download.size ||
+        download.file.write(data) != data.size()) {
+        finishDownload(hash, false);
+        return;
+    }
+    download.hasher.addData(data);
+    download.received += data.size();
+    if (download.received == download.size) {
+        finishDownload(hash, download.hasher.result() == hash);
+    }
+}
+
+void ClientConnection::finishDownload(const QByteArray& hash, bool success)
+{
+    const auto found                         = downloads.find(hash);
+    const std::unique_ptr<Download> download = std::move(found->second);
+    downloads.erase(found);
+    download->file.close();
+    if (success) {
+        QFile::remove(download->path);
+        success = download->file.rename(download->path);
+    }
+    if (!success) {
+        download->file.remove();
+    }
+    emit downloadFinishedSig(download->groupName, download->path, success);
+}
+
+void ClientConnection::onError(const QAbstractSocket::SocketError socketError)
+{
+    emit errorSig(socketError, clientSocket->state());
+}
+
+bool ClientConnection::isEqualPacketType(const QJsonValue& jsonType, const char* const strType)
+{
+    return jsonType.toString().compare(QLatin1String(strType), Qt::CaseInsensitive) == 0;
+}
+
+void ClientConnection::flushMessages()
+{
+    flushTimer->stop();
+    if (pendingMessages.isEmpty()) {
+        return;
+    }
+    emit messagesReceivedSig(pendingMessages);
+    pendingMessages.clear();
+}
+
+/* entries of a message list leave the group name to the packet */
+Message ClientConnection::parseMessage(const QJsonObject& obj, const QString& groupName)
+{
+    const qint64 id        = static_cast<qint64>(obj[Packet::Data::ID].toDouble(0));
+    const qint64 timestamp = static_cast<qint64>(obj[Packet::Data::TIMESTAMP].toDouble(0));
+    Message message(groupName, obj[Packet::Data::SENDER].toString(), obj[Packet::Data::TEXT].toString(),
+                    obj[Packet::Data::TIME].toString(), id, timestamp);
+    if (obj.contains(Packet::Data::FILE_HASH)) {
+        message.setAttachment(obj[Packet::Data::FILE_HASH].toString(),
+                              static_cast<qint64>(obj[Packet::Data::FILE_SIZE].toDouble(0)));
+    }
+    return message;
+}
+
+void ClientConnection::handleMessagePacket(const QJsonObject& packet)
+{
+    const QJsonValue senderVal = packet.value(QLatin1String(Packet::Data::SENDER));
+    if (senderVal.isNull() || !senderVal.isString()) {
+        return;
+    }
+    const QJsonValue textVal = packet.value(QLatin1String(Packet::Data::TEXT));
+    if (textVal.isNull() || !textVal.isString()) {
+        return;
+    }
+    const QJsonValue timeVal = packet.value(QLatin1String(Packet::Data::TIME));
+    if (timeVal.isNull() || !timeVal.isString()) {
+        return;
+    }
+    const Message message = parseMessage(packet, packet[Packet::Data::GROUP_NAME].toString());
+    const auto cache      = caches.find(message.getGroupName());
+    if (cache != caches.end() && message.getId() != 0) {
+        cache->second->append({message});
+    }
+    // own messages are already on screen, the echo only brings their id, files show up once stored
+    if (message.getSender() == selfName && message.getAttachment().isEmpty()) {
+        return;
+    }
+    pendingMessages.push_back(message);
+    if (!flushTimer->isActive()) {
+        flushTimer->start();
+    }
+}
+
+void ClientConnection::handleInformJoinerPacket(const QJsonObject& packet)
+{
+    const QJsonValue usernamesVal = packet.value(QLatin1String(Packet::Data::USERNAMES));
+    if (usernamesVal.isNull() || !usernamesVal.isArray()) {
+        return;
+    }
+    QJsonArray jsonUsernames = usernamesVal.toArray();
+    QStringList usernames;
+    usernames.reserve(jsonUsernames.size());
+    for (const auto& jsonUsername : jsonUsernames) {
+        usernames.push_back(jsonUsername.toString());
+    }
+
+    const QJsonValue messagesVal = packet.value(QLatin1String(Packet::Data::MESSAGES));
+    if (messagesVal.isNull() || !messagesVal.isArray()) {
+        return;
+    }
+
+    const QString groupName = packet.value(QLatin1String(Packet::Data::GROUP_NAME)).toString();
+    QJsonArray jsonMessages = messagesVal.toArray();
+    QList<Message> messages;
+    messages.reserve(jsonMessages.size());
+    for (const auto& jsonMessage : jsonMessages) {
+        messages.push_back(parseMessage(jsonMessage.toObject(), groupName));
+    }
+
+    QList<Message> history;
+    const auto cache = caches.find(groupName);
+    if (cache != caches.end()) {
+        cache->second->append(messages);
+        history = cachedMessages.take(groupName);
+    }
+    history += messages;
+    emit informJoinerSig(groupName, usernames, history);
+}
+
+void ClientConnection::handleSearchPacket(const QJsonObject& packet)
+{
+    const QJsonValue messagesVal = packet.value(QLatin1String(Packet::Data::MESSAGES));
+    if (messagesVal.isNull() || !messagesVal.isArray()) {
+        return;
+    }
+
+    const QString groupName = packet.value(QLatin1String(Packet::Data::GROUP_NAME)).toString();
+    QJsonArray jsonMessages = messagesVal.toArray();
+    QList<Message> hits;
+    hits.reserve(jsonMessages.size());
+    for (const auto& jsonMessage : jsonMessages) {
+        hits.push_back(parseMessage(jsonMessage.toObject(), groupName));
+    }
+    emit searchResultsSig(groupName, packet.value(QLatin1String(Packet::Data::QUERY)).toString(), hits,
+                          packet.value(QLatin1String(Packet::Data::HAS_MORE)).toBool());
+}
+
+void ClientConnection::handleHistoryPacket(const QJsonObject& packet)
+{
+    const QJsonValue messagesVal = packet.value(QLatin1String(Packet::Data::MESSAGES));
+    if (messagesVal.isNull() || !messagesVal.isArray()) {
+        return;
+    }
+
+    const QString groupName = packet.value(QLatin1String(Packet::Data::GROUP_NAME)).toString();
+    QJsonArray jsonMessages = messagesVal.toArray();
+    QList<Message> messages;
+    messages.reserve(jsonMessages.size());
+    for (const auto& jsonMessage : jsonMessages) {
+        messages.push_back(parseMessage(jsonMessage.toObject(), groupName));
+    }
+    emit historyRangeSig(groupName, messages, packet.value(QLatin1String(Packet::Data::HAS_MORE)).toBool());
+}
+
+void ClientConnection::packetReceived(const QJsonObject& packet)
+{
+    const QJsonValue packetTypeVal = packet.value(QLatin1String(Packet::Type::TYPE));
+    if (packetTypeVal.isNull() || !packetTypeVal.isString()) {
+        return;
+    }
+
+    if (isEqualPacketType(packetTypeVal, Packet::Type::MESSAGE)) {
+        handleMessagePacket(packet);
+        return;
+    }
+    // keep the packet order, earlier messages go first
+    flushMessages();
+    if (isEqualPacketType(packetTypeVal, Packet::Type::INFORM_JOINER)) {
+        handleInformJoinerPacket(packet);
+    } else if (isEqualPacketType(packetTypeVal, Packet::Type::SEARCH)) {
+        handleSearchPacket(packet);
+    } else if (isEqualPacketType(packetTypeVal, Packet::Type::HISTORY)) {
+        handleHistoryPacket(packet);
+    } else if (isEqualPacketType(packetTypeVal, Packet::Type::FILE_OFFER)) {
+        handleFileOfferPacket(packet);
+    } else if (isEqualPacketType(packetTypeVal, Packet::Type::FILE_DOWNLOAD)) {
+        handleFileDownloadPacket(packet);
+    } else {
+        emit packetReceivedSig(packet);
+    }
+}
+
+void ClientConnection::onReadyRead()
+{
+    QByteArray jsonData;
+    QDataStream socketStream(clientSocket);
+    socketStream.setVersion(SERIALIZER_VERSION);
+
+    while (true) {
+        socketStream.startTransaction();
+        socketStream >> jsonData;
+        if (socketStream.commitTransaction()) {
+            if (FileChunk::isChunk(jsonData)) {
+                receiveChunk(jsonData);
+                continue;
+            }
+            QJsonParseError parseError  = {0};
+            const QJsonDocument jsonDoc = QJsonDocument::fromJson(jsonData, &parseError);
+            if (parseError.error == QJsonParseError::NoError) {
+                if (jsonDoc.isObject()) {
+                    packetReceived(jsonDoc.object());
+                }
+            }
+        } else {
+            break;
+        }
+    }
+}
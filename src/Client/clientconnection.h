@@ -0,0 +1,99 @@
+#ifndef CLIENT_CONNECTION_H
+#define CLIENT_CONNECTION_H
+
+#include <QObject>
+#include <QSslSocket>
+#include <QJsonObject>
+#include <QTimer>
+#include <QHash>
+#include <QFile>
+#include <QCryptographicHash>
+#include <map>
+#include <memory>
+#include <vector>
+#include "message.h"
+#include "messagecache.h"
+
+/* socket I/O and packet decoding, lives on the network thread of ClientCore */
+class ClientConnection : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(ClientConnection)
+public:
+    explicit ClientConnection(QObject* parent = nullptr);
+    ~ClientConnection() override;
+    void connectToServer(const QString& host, quint16 port);
+    void sendPacket(const QJsonObject& packet);
+    void joinGroup(QJsonObject packet, const QString& server, const QString& epoch, const QString& userName);
+    void leaveGroup(const QJsonObject& packet);
+    /* hashes the file a slice at a time, offers it to the group and streams what the server asks for */
+    void uploadFile(const QString& groupName, const QString& path);
+    void downloadFile(const QString& groupName, const QString& hash, const QString& path);
+    void disconnectFromHost();
+    void abort();
+
+private slots:
+    void onReadyRead();
+    void onError(QAbstractSocket::SocketError socketError);
+    void flushMessages();
+    void sendChunks();
+signals:
+    void connectedSig();
+    void disconnectedSig();
+    void errorSig(QAbstractSocket::SocketError socketError, QAbstractSocket::SocketState socketState);
+    void packetReceivedSig(const QJsonObject& packet);
+    void messagesReceivedSig(const QList<Message>& messages);
+    void historyLoadedSig(const QString& groupName, const QList<Message>& messages);
+    void informJoinerSig(const QString& groupName, const QStringList& usernames, const QList<Message>& messages);
+    void historyRangeSig(const QString& groupName, const QList<Message>& messages, bool hasMore);
+    void searchResultsSig(const QString& groupName, const QString& query, const QList<Message>& hits, bool hasMore);
+    void uploadFailedSig(const QString& groupName, const QString& fileName, const QString& reason);
+    void downloadFinishedSig(const QString& groupName, const QString& path, bool success);
+
+private:
+    struct Upload {
+        quint64 id = 0;
+        QString groupName;
+        QFile file;
+        QCryptographicHash hasher{QCryptographicHash::Sha256};
+        QByteArray hash;    // empty while hashing
+        qint64 size   = 0;
+        qint64 offset = -1; // where the server wants data from, -1 until it answered the offer
+    };
+    struct Download {
+        QString groupName;
+        QString path;
+        QFile file; // <path>.part until the hash checks out
+        QCryptographicHash hasher{QCryptographicHash::Sha256};
+        qint64 size     = -1; // known once the server answered
+        qint64 received = 0;
+    };
+    void packetReceived(const QJsonObject& packet);
+    void handleMessagePacket(const QJsonObject& packet);
+    void handleInformJoinerPacket(const QJsonObject& packet);
+    void handleSearchPacket(const QJsonObject& packet);
+    void handleHistoryPacket(const QJsonObject& packet);
+    void handleFileOfferPacket(const QJsonObject& packet);
+    void handleFileDownloadPacket(const QJsonObject& packet);
+    void hashUpload(quint64 uploadId);
+    void receiveChunk(const QByteArray& frame);
+    void finishDownload(const QByteArray& hash, bool success);
+    void dropTransfers();
+    static bool isEqualPacketType(const QJsonValue& jsonType, const char* strType);
+    static Message parseMessage(const QJsonObject& obj, const QString& groupName);
+
+private:
+    QSslSocket* clientSocket;
+    QTimer* flushTimer;
+    QList<Message> pendingMessages;
+    std::map<QString, std::unique_ptr<MessageCache>> caches;
+    QHash<QString, QList<Message>> cachedMessages;
+    QString selfName;
+    std::vector<std::unique_ptr<Upload>> uploads;              // chunks are sent round robin
+    std::map<QByteArray, std::unique_ptr<Download>> downloads; // raw sha-256 -> download
+    quint64 lastUploadId = 0;
+    static constexpr int flushInterval = 16;          // about one frame
+    static constexpr qint64 hashSlice  = 1024 * 1024; // bytes hashed per event loop pass
+};
+
+#endif // CLIENT_CONNECTION_H
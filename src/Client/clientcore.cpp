@@ -1,39 +1,42 @@
-#include <QTcpSocket>
-#include <QDataStream>
-#include <QJsonParseError>
 #include <QJsonObject>
 #include <QJsonArray>
-#include <QFile>
+#include <random>
 #include "clientcore.h"
 #include "constants.h"
 
-ClientCore::ClientCore(QObject* parent) : QObject(parent), clientSocket(new QSslSocket(this))
+ClientCore::ClientCore(QObject* parent)
+    : QObject(parent), networkThread(new QThread(this)), connection(new ClientConnection),
+      reconnectTimer(new QTimer(this)), serverPort(0), state(State::Offline), reconnecting(false), reconnectAttempt(0),
+      pendingRejoins(0), drainDelay(-1), resumingWithToken(false)
 {
-#ifdef SSL_ENABLE
-    clientSocket->setProtocol(QSsl::SslV3);
-    QByteArray certificate;
-    QFile fileCertificate("ssl/ssl.cert");
-    if (fileCertificate.open(QIODevice::ReadOnly)) {
-        certificate = fileCertificate.readAll();
-        fileCertificate.close();
-    } else {
-        qWarning() << fileCertificate.errorString();
-    }
-    QSslCertificate sslCertificate(certificate);
-    clientSocket->setLocalCertificate(sslCertificate);
-#endif
-
-    connect(clientSocket, &QSslSocket::connected, this, &ClientCore::connectedSig);
-    connect(clientSocket, &QSslSocket::disconnected, this, &ClientCore::disconnectedSig);
-
-    connect(clientSocket, &QSslSocket::readyRead, this, &ClientCore::onReadyRead);
-    connect(clientSocket, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error), this,
-            &ClientCore::errorSig);
+    qRegisterMetaType<Message>("Message");
+    qRegisterMetaType<QList<Message>>("QList<Message>");
+    qRegisterMetaType<QAbstractSocket::SocketError>("QAbstractSocket::SocketError");
+    qRegisterMetaType<QAbstractSocket::SocketState>("QAbstractSocket::SocketState");
+
+    reconnectTimer->setSingleShot(true);
+    connect(reconnectTimer, &QTimer::timeout, this, &ClientCore::reconnect);
+
+    connection->moveToThread(networkThread);
+    connect(networkThread, &QThread::finished, connection, &QObject::deleteLater);
+    connect(connection, &ClientConnection::connectedSig, this, &ClientCore::onConnected);
+    connect(connection, &ClientConnection::disconnectedSig, this, &ClientCore::onDisconnected);
+    connect(connection, &ClientConnection::errorSig, this, &ClientCore::onError);
+    connect(connection, &ClientConnection::packetReceivedSig, this, &ClientCore::packetReceived);
+    connect(connection, &ClientConnection::messagesReceivedSig, this, &ClientCore::messagesReceivedSig);
+    connect(connection, &ClientConnection::informJoinerSig, this, &ClientCore::onInformJoiner);
+    connect(connection, &ClientConnection::historyLoadedSig, this, &ClientCore::historyLoadedSig);
+    connect(connection, &ClientConnection::historyRangeSig, this, &ClientCore::historyRangeSig);
+    connect(connection, &ClientConnection::searchResultsSig, this, &ClientCore::searchResultsSig);
+    connect(connection, &ClientConnection::uploadFailedSig, this, &ClientCore::uploadFailedSig);
+    connect(connection, &ClientConnection::downloadFinishedSig, this, &ClientCore::downloadFinishedSig);
+    networkThread->start();
 }
 
 ClientCore::~ClientCore()
 {
-    delete clientSocket;
+    networkThread->quit();
+    networkThread->wait();
 }
 
 QString ClientCore::getName() const
@@ -41,91 +44,320 @@ QString ClientCore::getName() const
     return name;
 }
 
+bool ClientCore::isReconnecting() const
+{
+    return reconnecting;
+}
+
 void ClientCore::connectToServer(const QHostAddress& address, const quint16 port)
 {
-    clientSocket->connectToHost(address, port);
-#ifdef SSL_ENABLE
-    clientSocket->startClientEncryption();
-#endif
+    serverAddress = address;
+    serverPort    = port;
+    if (!reconnecting) {
+        state = State::Connecting;
+    }
+    const QString host = address.toString();
+    QTimer::singleShot(0, connection, [connection = this->connection, host, port] {
+        connection->connectToServer(host, port);
+    });
+}
+
+void ClientCore::writePacket(const QJsonObject& packet)
+{
+    QTimer::singleShot(0, connection, [connection = this->connection, packet] { connection->sendPacket(packet); });
+}
+
+bool ClientCore::isConnected() const
+{
+    return state == State::Connected || state == State::LoggedIn || state == State::InGroup;
 }
 
 void ClientCore::login(const QString& username, const QString& password)
 {
-    if (clientSocket->state() == QAbstractSocket::ConnectedState) {
-        this->name = username;
-        QDataStream clientStream(clientSocket);
-        clientStream.setVersion(SERIALIZER_VERSION);
+    if (isConnected()) {
+        this->name     = username;
+        this->password = password;
 
         QJsonObject packet;
         packet[Packet::Type::TYPE]     = Packet::Type::LOGIN;
         packet[Packet::Data::USERNAME] = username;
         packet[Packet::Data::PASSWORD] = password;
-        clientStream << QJsonDocument(packet).toJson(QJsonDocument::Compact);
+        writePacket(packet);
     }
 }
 
 void ClientCore::registerUser(const QString& username, const QString& password)
 {
-    if (clientSocket->state() == QAbstractSocket::ConnectedState) {
-        QDataStream clientStream(clientSocket);
-        clientStream.setVersion(SERIALIZER_VERSION);
-
+    if (isConnected()) {
         QJsonObject packet;
         packet[Packet::Type::TYPE]     = Packet::Type::REGISTER;
         packet[Packet::Data::USERNAME] = username;
         packet[Packet::Data::PASSWORD] = password;
-        clientStream << QJsonDocument(packet).toJson(QJsonDocument::Compact);
+        writePacket(packet);
     }
 }
 
 void ClientCore::connectGroup(const QString& groupName, const QString& password)
 {
-    if (clientSocket->state() == QAbstractSocket::ConnectedState) {
-        this->group = groupName;
-        QDataStream clientStream(clientSocket);
-        clientStream.setVersion(SERIALIZER_VERSION);
+    if (isConnected()) {
+        groups.insert(groupName, password);
 
         QJsonObject packet;
         packet[Packet::Type::TYPE]       = Packet::Type::CONNECT_GROUP;
         packet[Packet::Data::GROUP_NAME] = groupName;
         packet[Packet::Data::USERNAME]   = this->name;
         packet[Packet::Data::PASSWORD]   = password;
-        clientStream << QJsonDocument(packet).toJson(QJsonDocument::Compact);
+
+        const QString server   = QString("%1:%2").arg(serverAddress.toString()).arg(serverPort);
+        const QString userName = this->name;
+        QTimer::singleShot(0, connection,
+                           [connection = this->connection, packet, server, epoch = historyEpoch, userName] {
+                               connection->joinGroup(packet, server, epoch, userName);
+                           });
     }
 }
 
-void ClientCore::createGroup(const QString& groupName, const QString& password)
+void ClientCore::leaveGroup(const QString& groupName)
 {
-    if (clientSocket->state() == QAbstractSocket::ConnectedState) {
-        QDataStream clientStream(clientSocket);
-        clientStream.setVersion(SERIALIZER_VERSION);
+    if (!groups.remove(groupName)) {
+        return;
+    }
+    if (groups.isEmpty() && state == State::InGroup) {
+        state = State::LoggedIn;
+    }
+
+    QJsonObject packet;
+    packet[Packet::Type::TYPE]       = Packet::Type::LEAVE_GROUP;
+    packet[Packet::Data::GROUP_NAME] = groupName;
+    QTimer::singleShot(0, connection, [connection = this->connection, packet] { connection->leaveGroup(packet); });
+}
 
+void ClientCore::createGroup(const QString& groupName, const QString& password)
+{
+    if (isConnected()) {
         QJsonObject packet;
         packet[Packet::Type::TYPE]       = Packet::Type::CREATE_GROUP;
         packet[Packet::Data::GROUP_NAME] = groupName;
         packet[Packet::Data::USERNAME]   = this->name;
         packet[Packet::Data::PASSWORD]   = password;
-        clientStream << QJsonDocument(packet).toJson(QJsonDocument::Compact);
+        writePacket(packet);
     }
 }
 
-void ClientCore::sendMessage(const QString& message, const QString& time)
+void ClientCore::sendMessage(const QString& groupName, const QString& message, const QString& time)
 {
-    QDataStream clientStream(clientSocket);
-    clientStream.setVersion(SERIALIZER_VERSION);
-
     QJsonObject packet;
     packet[Packet::Type::TYPE]       = Packet::Type::MESSAGE;
-    packet[Packet::Data::GROUP_NAME] = this->group;
+    packet[Packet::Data::GROUP_NAME] = groupName;
     packet[Packet::Data::SENDER]     = this->name;
     packet[Packet::Data::TEXT]       = message;
     packet[Packet::Data::TIME]       = time;
-    clientStream << QJsonDocument(packet).toJson();
+
+    // keep outgoing messages until the session is restored
+    if (reconnecting) {
+        if (pendingPackets.size() < maxPendingPackets) {
+            pendingPackets.enqueue(packet);
+        }
+        return;
+    }
+    writePacket(packet);
+}
+
+void ClientCore::search(const QString& groupName, const QString& query, const qint64 beforeId)
+{
+    if (!groups.contains(groupName) || reconnecting) {
+        return;
+    }
+    QJsonObject packet;
+    packet[Packet::Type::TYPE]       = Packet::Type::SEARCH;
+    packet[Packet::Data::GROUP_NAME] = groupName;
+    packet[Packet::Data::QUERY]      = query;
+    packet[Packet::Data::BEFORE_ID]  = static_cast<double>(beforeId);
+    writePacket(packet);
+}
+
+void ClientCore::requestHistory(const QString& groupName, const qint64 from, const qint64 to, const qint64 afterId)
+{
+    if (!groups.contains(groupName) || reconnecting) {
+        return;
+    }
+    QJsonObject packet;
+    packet[Packet::Type::TYPE]       = Packet::Type::HISTORY;
+    packet[Packet::Data::GROUP_NAME] = groupName;
+    packet[Packet::Data::FROM]       = static_cast<double>(from);
+    packet[Packet::Data::TO]         = static_cast<double>(to);
+    packet[Packet::Data::LAST_ID]    = static_cast<double>(afterId);
+    writePacket(packet);
+}
+
+void ClientCore::sendFile(const QString& groupName, const QString& path)
+{
+    if (!groups.contains(groupName) || reconnecting) {
+        return;
+    }
+    QTimer::singleShot(0, connection, [connection = this->connection, groupName, path] {
+        connection->uploadFile(groupName, path);
+    });
+}
+
+void ClientCore::downloadFile(const QString& groupName, const QString& hash, const QString& path)
+{
+    if (!groups.contains(groupName) || reconnecting) {
+        return;
+    }
+    QTimer::singleShot(0, connection, [connection = this->connection, groupName, hash, path] {
+        connection->downloadFile(groupName, hash, path);
+    });
 }
 
 void ClientCore::disconnectFromHost()
 {
-    clientSocket->disconnectFromHost();
+    reconnectTimer->stop();
+    reconnecting     = false;
+    reconnectAttempt = 0;
+    state            = State::Offline;
+    drainDelay       = -1;
+    pendingPackets.clear();
+    resumeToken.clear();
+    QTimer::singleShot(0, connection, [connection = this->connection] { connection->disconnectFromHost(); });
+    emit disconnectedSig();
+}
+
+bool ClientCore::canReconnect() const
+{
+    return reconnecting || state == State::LoggedIn || state == State::InGroup;
+}
+
+void ClientCore::onConnected()
+{
+    state = State::Connected;
+    if (reconnecting) {
+        resumeSession();
+        return;
+    }
+    emit connectedSig();
+}
+
+/* a token from a draining server skips the password check, saved credentials are the fallback */
+void ClientCore::resumeSession()
+{
+    if (resumeToken.isEmpty()) {
+        resumingWithToken = false;
+        login(name, password);
+        return;
+    }
+    resumingWithToken = true;
+    QJsonObject packet;
+    packet[Packet::Type::TYPE]     = Packet::Type::LOGIN;
+    packet[Packet::Data::USERNAME] = name;
+    packet[Packet::Data::TOKEN]    = resumeToken;
+    resumeToken.clear(); // tokens are single use
+    writePacket(packet);
+}
+
+void ClientCore::onDisconnected()
+{
+    // the loss was already reported by disconnectFromHost() or abandonReconnect()
+    if (state == State::Offline && !reconnecting) {
+        return;
+    }
+    if (canReconnect()) {
+        scheduleReconnect();
+        return;
+    }
+    state = State::Offline;
+    emit disconnectedSig();
+}
+
+void ClientCore::onError(const QAbstractSocket::SocketError socketError, const QAbstractSocket::SocketState socketState)
+{
+    if (canReconnect()) {
+        if (socketState == QAbstractSocket::UnconnectedState) {
+            scheduleReconnect();
+        }
+        return;
+    }
+    emit errorSig(socketError);
+}
+
+/* exponential backoff with equal jitter spreads reconnects of many clients over time */
+void ClientCore::scheduleReconnect()
+{
+    if (reconnectTimer->isActive()) {
+        return;
+    }
+    if (reconnectAttempt >= maxReconnectAttempts) {
+        abandonReconnect();
+        return;
+    }
+    reconnecting = true;
+
+    const int exponent = qMin(reconnectAttempt, 16);
+    const int delay    = static_cast<int>(qMin<qint64>(reconnectMaxDelay, qint64(reconnectBaseDelay) << exponent));
+    static std::mt19937 randomEngine{std::random_device{}()};
+    int jittered = std::uniform_int_distribution<int>(delay / 2, delay)(randomEngine);
+    // the draining server already spread its clients over time
+    if (drainDelay >= 0) {
+        jittered   = drainDelay;
+        drainDelay = -1;
+    }
+    ++reconnectAttempt;
+
+    qInfo() << qPrintable(QString("reconnect attempt %1 in %2 ms").arg(reconnectAttempt).arg(jittered));
+    reconnectTimer->start(jittered);
+    emit reconnectingSig(reconnectAttempt, jittered);
+}
+
+void ClientCore::reconnect()
+{
+    connectToServer(serverAddress, serverPort);
+}
+
+void ClientCore::rejoinFinished()
+{
+    if (--pendingRejoins <= 0) {
+        finishReconnect();
+    }
+}
+
+void ClientCore::finishReconnect()
+{
+    reconnecting     = false;
+    reconnectAttempt = 0;
+    pendingRejoins   = 0;
+    QList<Message> flushed;
+    while (!pendingPackets.isEmpty()) {
+        const QJsonObject packet = pendingPackets.dequeue();
+        const QString groupName  = packet[Packet::Data::GROUP_NAME].toString();
+        if (!groups.contains(groupName)) {
+            continue;
+        }
+        writePacket(packet);
+        flushed.push_back(
+            {groupName, name, packet[Packet::Data::TEXT].toString(), packet[Packet::Data::TIME].toString()});
+    }
+    if (!flushed.isEmpty()) {
+        emit messagesReceivedSig(flushed);
+    }
+    qInfo() << "session restored";
+    emit reconnectedSig();
+}
+
+void ClientCore::abandonReconnect()
+{
+    reconnectTimer->stop();
+    reconnecting     = false;
+    reconnectAttempt = 0;
+    state            = State::Offline;
+    pendingPackets.clear();
+    password.clear();
+    groups.clear();
+    resumeToken.clear();
+    drainDelay = -1;
+
+    QTimer::singleShot(0, connection, [connection = this->connection] { connection->abort(); });
+    qWarning() << "unable to restore the session";
+    emit disconnectedSig();
 }
 
 bool ClientCore::isEqualPacketType(const QJsonValue& jsonType, const char* const strType)
@@ -141,9 +373,31 @@ void ClientCore::handleLoginPacket(const QJsonObject& packet)
     }
     const bool loginSuccess = successVal.toBool();
     if (loginSuccess) {
+        state        = State::LoggedIn;
+        historyEpoch = packet.value(QLatin1String(Packet::Data::EPOCH)).toString();
+        if (reconnecting) {
+            if (groups.isEmpty()) {
+                finishReconnect();
+                return;
+            }
+            // every subscription is restored before the queued messages go out
+            pendingRejoins = groups.size();
+            for (auto it = groups.cbegin(); it != groups.cend(); ++it) {
+                connectGroup(it.key(), it.value());
+            }
+            return;
+        }
         emit loggedInSig();
         return;
     }
+    if (reconnecting) {
+        if (resumingWithToken) {
+            resumeSession();
+            return;
+        }
+        abandonReconnect();
+        return;
+    }
     const QJsonValue reasonVal = packet.value(QLatin1String(Packet::Data::REASON));
     emit loginErrorSig(reasonVal.toString());
 }
@@ -169,13 +423,19 @@ void ClientCore::handleConnectedToGroup(const QJsonObject& packet)
     if (successVal.isNull() || !successVal.isBool()) {
         return;
     }
+    const QString groupName          = packet.value(QLatin1String(Packet::Data::GROUP_NAME)).toString();
     const bool connectToGroupSuccess = successVal.toBool();
     if (connectToGroupSuccess) {
-        emit connectedToGroupSig();
+        state = State::InGroup;
+        emit connectedToGroupSig(groupName);
         return;
     }
+    groups.remove(groupName);
+    if (reconnecting) {
+        rejoinFinished();
+    }
     const QJsonValue reasonVal = packet.value(QLatin1String(Packet::Data::REASON));
-    emit connectToGroupErrorSig(reasonVal.toString());
+    emit connectToGroupErrorSig(groupName, reasonVal.toString());
 }
 
 void ClientCore::handleCreatedGroup(const QJsonObject& packet)
@@ -193,69 +453,72 @@ void ClientCore::handleCreatedGroup(const QJsonObject& packet)
     emit createdGroupErrorSig(reasonVal.toString());
 }
 
-void ClientCore::handleMessagePacket(const QJsonObject& packet)
+void ClientCore::handlePresencePacket(const QJsonObject& packet)
 {
-    const QJsonValue senderVal = packet.value(QLatin1String(Packet::Data::SENDER));
-    if (senderVal.isNull() || !senderVal.isString()) {
+    const QJsonValue groupNameVal = packet.value(QLatin1String(Packet::Data::GROUP_NAME));
+    if (groupNameVal.isNull() || !groupNameVal.isString()) {
         return;
     }
-    const QJsonValue textVal = packet.value(QLatin1String(Packet::Data::TEXT));
-    if (textVal.isNull() || !textVal.isString()) {
+    const QJsonValue joinedVal = packet.value(QLatin1String(Packet::Data::JOINED));
+    const QJsonValue leftVal   = packet.value(QLatin1String(Packet::Data::LEFT));
+    if (!joinedVal.isArray() || !leftVal.isArray()) {
         return;
     }
-    const QJsonValue timeVal = packet.value(QLatin1String(Packet::Data::TIME));
-    if (timeVal.isNull() || !timeVal.isString()) {
-        return;
+
+    // our own join comes back in the delta too
+    QStringList joined;
+    for (const auto& jsonUsername : joinedVal.toArray()) {
+        const QString username = jsonUsername.toString();
+        if (!username.isEmpty() && username != name) {
+            joined.push_back(username);
+        }
+    }
+    QStringList left;
+    for (const auto& jsonUsername : leftVal.toArray()) {
+        const QString username = jsonUsername.toString();
+        if (!username.isEmpty()) {
+            left.push_back(username);
+        }
+    }
+    if (!joined.isEmpty() || !left.isEmpty()) {
+        emit presenceChangedSig(groupNameVal.toString(), joined, left);
     }
-    emit messageReceivedSig({"", senderVal.toString(), textVal.toString(), timeVal.toString()});
 }
 
-void ClientCore::handleUserJoinedPacket(const QJsonObject& packet)
+void ClientCore::handleDrainPacket(const QJsonObject& packet)
 {
-    const QJsonValue usernameVal = packet.value(QLatin1String(Packet::Data::USERNAME));
-    if (usernameVal.isNull() || !usernameVal.isString()) {
+    const QJsonValue retryAfterVal = packet.value(QLatin1String(Packet::Data::RETRY_AFTER));
+    if (!retryAfterVal.isDouble() || !canReconnect()) {
         return;
     }
-    emit userJoinedSig(usernameVal.toString());
+    drainDelay = qBound(0, retryAfterVal.toInt(), reconnectMaxDelay);
+    const QJsonValue tokenVal = packet.value(QLatin1String(Packet::Data::TOKEN));
+    if (tokenVal.isString()) {
+        resumeToken = tokenVal.toString();
+    }
+    qInfo() << qPrintable(QString("server is restarting, reconnect in %1 ms").arg(drainDelay));
+    // leave now, the disconnect schedules the reconnect at the requested time
+    reconnecting = true;
+    QTimer::singleShot(0, connection, [connection = this->connection] { connection->disconnectFromHost(); });
 }
 
-void ClientCore::handleUserLeftPacket(const QJsonObject& packet)
+void ClientCore::handleSlowDownPacket(const QJsonObject& packet)
 {
-    const QJsonValue usernameVal = packet.value(QLatin1String(Packet::Data::USERNAME));
-    if (usernameVal.isNull() || !usernameVal.isString()) {
+    const QJsonValue groupNameVal  = packet.value(QLatin1String(Packet::Data::GROUP_NAME));
+    const QJsonValue retryAfterVal = packet.value(QLatin1String(Packet::Data::RETRY_AFTER));
+    if (!groupNameVal.isString() || !retryAfterVal.isDouble()) {
         return;
     }
-    emit userLeftSig(usernameVal.toString());
+    emit slowDownSig(groupNameVal.toString(), qMax(retryAfterVal.toInt(), 0));
 }
 
-void ClientCore::handleInformJoinerPacket(const QJsonObject& packet)
+void ClientCore::onInformJoiner(const QString& groupName, const QStringList& usernames,
+                                const QList<Message>& messages)
 {
-    const QJsonValue usernamesVal = packet.value(QLatin1String(Packet::Data::USERNAMES));
-    if (usernamesVal.isNull() || !usernamesVal.isArray()) {
-        return;
-    }
-    QJsonArray jsonUsernames = usernamesVal.toArray();
-    QStringList usernames;
-    for (const auto& jsonUsername : jsonUsernames) {
-        usernames.push_back(jsonUsername.toString());
+    emit informJoinerSig(groupName, usernames, messages);
+    if (reconnecting) {
+        rejoinFinished();
     }
-
-    const QJsonValue messagesVal = packet.value(QLatin1String(Packet::Data::MESSAGES));
-    if (messagesVal.isNull() || !messagesVal.isArray()) {
-        return;
-    }
-
-    QJsonArray jsonMessages = messagesVal.toArray();
-    QList<Message> messages;
-    for (const auto& jsonMessage : jsonMessages) {
-        QJsonObject obj   = jsonMessage.toObject();
-        QString groupName = obj[Packet::Data::GROUP_NAME].toString();
-        QString sender    = obj[Packet::Data::SENDER].toString();
-        QString text      = obj[Packet::Data::TEXT].toString();
-        QString time      = obj[Packet::Data::TIME].toString();
-        messages.push_back({groupName, sender, text, time});
-    }
-    emit informJoinerSig(usernames, messages);
 }
 
 void ClientCore::packetReceived(const QJsonObject& packet)
@@ -273,36 +536,15 @@ void ClientCore::packetReceived(const QJsonObject& packet)
         handleConnectedToGroup(packet);
     } else if (isEqualPacketType(packetTypeVal, Packet::Type::CREATE_GROUP)) {
         handleCreatedGroup(packet);
-    } else if (isEqualPacketType(packetTypeVal, Packet::Type::MESSAGE)) {
-        handleMessagePacket(packet);
-    } else if (isEqualPacketType(packetTypeVal, Packet::Type::USER_JOINED)) {
-        handleUserJoinedPacket(packet);
-    } else if (isEqualPacketType(packetTypeVal, Packet::Type::USER_LEFT)) {
-        handleUserLeftPacket(packet);
-    } else if (isEqualPacketType(packetTypeVal, Packet::Type::INFORM_JOINER)) {
-        handleInformJoinerPacket(packet);
-    }
-}
-
-void ClientCore::onReadyRead()
-{
-    QByteArray jsonData;
-    QDataStream socketStream(clientSocket);
-    socketStream.setVersion(SERIALIZER_VERSION);
-
-    while (true) {
-        socketStream.startTransaction();
-        socketStream >> jsonData;
-        if (socketStream.commitTransaction()) {
-            QJsonParseError parseError  = {0};
-            const QJsonDocument jsonDoc = QJsonDocument::fromJson(jsonData, &parseError);
-            if (parseError.error == QJsonParseError::NoError) {
-                if (jsonDoc.isObject()) {
-                    packetReceived(jsonDoc.object());
-                }
-            }
-        } else {
-            break;
-        }
+    } else if (isEqualPacketType(packetTypeVal, Packet::Type::PRESENCE)) {
+        handlePresencePacket(packet);
+    } else if (isEqualPacketType(packetTypeVal, Packet::Type::DRAIN)) {
+        handleDrainPacket(packet);
+    } else if (isEqualPacketType(packetTypeVal, Packet::Type::SLOW_DOWN)) {
+        handleSlowDownPacket(packet);
+    } else if (isEqualPacketType(packetTypeVal, Packet::Type::PING)) {
+        QJsonObject pongPacket;
+        pongPacket[Packet::Type::TYPE] = Packet::Type::PONG;
+        writePacket(pongPacket);
     }
 }
@@ -2,11 +2,16 @@
 #define CLIENT_CORE_H
 
 #include <QObject>
-#include <QSslSocket>
-#include <QTcpSocket>
+#include <QAbstractSocket>
 #include <QHostAddress>
+#include <QThread>
 #include <QJsonDocument>
+#include <QJsonObject>
+#include <QQueue>
+#include <QHash>
+#include <QTimer>
 #include "message.h"
+#include "clientconnection.h"
 
 class ClientCore : public QObject
 {
@@ -20,44 +25,99 @@ public:
     void login(const QString& username, const QString& password);
     void registerUser(const QString& username, const QString& password);
     void connectGroup(const QString& groupName, const QString& password);
+    void leaveGroup(const QString& groupName);
     void createGroup(const QString& groupName, const QString& password);
-    void sendMessage(const QString& message, const QString& time);
+    void sendMessage(const QString& groupName, const QString& message, const QString& time);
+    /* hits come newest first, pass the oldest id of a page as beforeId for the next one */
+    void search(const QString& groupName, const QString& query, qint64 beforeId = 0);
+    /* messages stamped in [from, to) in ms since epoch, to 0 runs up to now, a page goes on after afterId */
+    void requestHistory(const QString& groupName, qint64 from, qint64 to = 0, qint64 afterId = 0);
+    /* the group gets the file as a message once the server stored it, chat goes on while it is sent */
+    void sendFile(const QString& groupName, const QString& path);
+    /* hash is the attachment of a message, the file ends up at path once its content checks out */
+    void downloadFile(const QString& groupName, const QString& hash, const QString& path);
     void disconnectFromHost();
+    [[nodiscard]] bool isReconnecting() const;
 
 private slots:
-    void onReadyRead();
+    void onConnected();
+    void onDisconnected();
+    void onError(QAbstractSocket::SocketError socketError, QAbstractSocket::SocketState socketState);
+    void onInformJoiner(const QString& groupName, const QStringList& usernames, const QList<Message>& messages);
+    void packetReceived(const QJsonObject& packet);
+    void reconnect();
 signals:
     void connectedSig();
     void disconnectedSig();
     void loggedInSig();
     void registeredSig();
-    void connectedToGroupSig();
+    void connectedToGroupSig(const QString& groupName);
     void createdGroupSig();
     void loginErrorSig(const QString& reason);
     void registerErrorSig(const QString& reason);
-    void connectToGroupErrorSig(const QString& reason);
+    void connectToGroupErrorSig(const QString& groupName, const QString& reason);
     void createdGroupErrorSig(const QString& reason);
-    void messageReceivedSig(const Message& message);
+    void messagesReceivedSig(const QList<Message>& messages);
     void errorSig(QAbstractSocket::SocketError socketError);
-    void userJoinedSig(const QString& username);
-    void userLeftSig(const QString& username);
-    void informJoinerSig(const QStringList& usernames, const QList<Message>& messages);
+    void presenceChangedSig(const QString& groupName, const QStringList& joined, const QStringList& left);
+    void informJoinerSig(const QString& groupName, const QStringList& usernames, const QList<Message>& messages);
+    void historyLoadedSig(const QString& groupName, const QList<Message>& messages);
+    void historyRangeSig(const QString& groupName, const QList<Message>& messages, bool hasMore);
+    void searchResultsSig(const QString& groupName, const QString& query, const QList<Message>& hits, bool hasMore);
+    void uploadFailedSig(const QString& groupName, const QString& fileName, const QString& reason);
+    void downloadFinishedSig(const QString& groupName, const QString& path, bool success);
+    /* the server dropped a message of ours to the group, nothing more gets through for retryAfter ms */
+    void slowDownSig(const QString& groupName, int retryAfter);
+    void reconnectingSig(int attempt, int delay);
+    void reconnectedSig();
 
 private:
-    QSslSocket* clientSocket;
-    QString group;
+    enum class State
+    {
+        Offline,
+        Connecting,
+        Connected,
+        LoggedIn,
+        InGroup
+    };
+    QThread* networkThread;
+    ClientConnection* connection;
+    QTimer* reconnectTimer;
+    QHostAddress serverAddress;
+    quint16 serverPort;
+    State state;
+    bool reconnecting;
+    int reconnectAttempt;
+    int pendingRejoins;
+    int drainDelay; // reconnect delay the draining server asked for, -1 if none
+    QString resumeToken;
+    QString historyEpoch; // of the server we are logged in to, a new one invalidates cached history
+    bool resumingWithToken;
+    QQueue<QJsonObject> pendingPackets;
+    QHash<QString, QString> groups; // joined group name -> group password
     QString name;
+    QString password;
+    static constexpr int reconnectBaseDelay   = 500;
+    static constexpr int reconnectMaxDelay    = 30000;
+    static constexpr int maxReconnectAttempts = 20;
+    static constexpr int maxPendingPackets    = 256;
 
 private:
-    void packetReceived(const QJsonObject& packet);
     void handleLoginPacket(const QJsonObject& packet);
     void handleRegisterPacket(const QJsonObject& packet);
     void handleConnectedToGroup(const QJsonObject& packet);
     void handleCreatedGroup(const QJsonObject& packet);
-    void handleMessagePacket(const QJsonObject& packet);
-    void handleUserJoinedPacket(const QJsonObject& packet);
-    void handleUserLeftPacket(const QJsonObject& packet);
-    void handleInformJoinerPacket(const QJsonObject& packet);
+    void handlePresencePacket(const QJsonObject& packet);
+    void handleDrainPacket(const QJsonObject& packet);
+    void handleSlowDownPacket(const QJsonObject& packet);
+    void resumeSession();
+    void writePacket(const QJsonObject& packet);
+    [[nodiscard]] bool isConnected() const;
+    [[nodiscard]] bool canReconnect() const;
+    void scheduleReconnect();
+    void rejoinFinished();
+    void finishReconnect();
+    void abandonReconnect();
     static bool isEqualPacketType(const QJsonValue& jsonType, const char* strType);
 };
 
@@ -1,4 +1,3 @@
-#include <QStandardItemModel>
 #include <QInputDialog>
 #include <QMessageBox>
 #include <QFormLayout>
@@ -7,25 +6,38 @@
 #include <QHostAddress>
 #include <QDateTime>
 #include <QTimer>
+#include <QScrollBar>
+#include <QMenu>
+#include <QDateEdit>
+#include <QFileDialog>
+#include <QFileInfo>
 #include "ui_window.h"
 #include "login.h"
 #include "register.h"
 #include "clientwindow.h"
 #include "constants.h"
+#include "chatdelegate.h"
 
 ClientWindow::ClientWindow(QWidget* parent)
     : QWidget(parent), ui(new Ui::ClientWindow), clientCore(new ClientCore(this)),
-      chatModel(new QStandardItemModel(this)), loadingScreen(new LoadingScreen), logged(false), loginWindow(new Login),
-      registerWindow(new Register), createGroupWindow(new CreateGroup)
+      loadingScreen(new LoadingScreen), logged(false), loginWindow(new Login),
+      registerWindow(new Register), createGroupWindow(new CreateGroup), searchWindow(new SearchResults)
 {
     // ui setup
     ui->setupUi(this);
     setSizePolicy(QSizePolicy::Minimum, QSizePolicy::Minimum);
     setMinimumSize(minWindowWidth, minWindowHeight);
     this->setWindowState(Qt::WindowState::WindowActive);
+    defaultTitle = windowTitle();
 
-    chatModel->insertColumn(0);
-    ui->chatView->setModel(chatModel);
+    ui->chatView->setItemDelegate(new ChatDelegate(ui->chatView));
+    ui->chatView->setResizeMode(QListView::Adjust);
+    ui->chatView->setLayoutMode(QListView::Batched);
+    ui->chatView->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    connect(ui->chatView->verticalScrollBar(), &QScrollBar::valueChanged, this, &ClientWindow::chatScrolled);
+    ui->groups->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(ui->groups, &QListWidget::currentTextChanged, this, &ClientWindow::groupSelected);
+    connect(ui->groups, &QWidget::customContextMenuRequested, this, &ClientWindow::groupsContextMenu);
 
     // connect ui and client core
     connect(clientCore, &ClientCore::connectedSig, loadingScreen, &LoadingScreen::close);
@@ -38,15 +50,24 @@ ClientWindow::ClientWindow(QWidget* parent)
     connect(clientCore, &ClientCore::registerErrorSig, this, &ClientWindow::registerError);
     connect(clientCore, &ClientCore::connectToGroupErrorSig, this, &ClientWindow::connectGroupError);
     connect(clientCore, &ClientCore::createdGroupErrorSig, this, &ClientWindow::createdGroupError);
-    connect(clientCore, &ClientCore::messageReceivedSig, this, &ClientWindow::messageReceived);
+    connect(clientCore, &ClientCore::messagesReceivedSig, this, &ClientWindow::messagesReceived);
     connect(clientCore, &ClientCore::disconnectedSig, this, &ClientWindow::disconnected);
+    connect(clientCore, &ClientCore::reconnectingSig, this, &ClientWindow::reconnecting);
+    connect(clientCore, &ClientCore::reconnectedSig, this, &ClientWindow::reconnected);
     connect(clientCore, &ClientCore::errorSig, this, &ClientWindow::error);
-    connect(clientCore, &ClientCore::userJoinedSig, this, &ClientWindow::userJoined);
-    connect(clientCore, &ClientCore::userLeftSig, this, &ClientWindow::userLeft);
+    connect(clientCore, &ClientCore::presenceChangedSig, this, &ClientWindow::presenceChanged);
     connect(clientCore, &ClientCore::informJoinerSig, this, &ClientWindow::informJoiner);
+    connect(clientCore, &ClientCore::historyLoadedSig, this, &ClientWindow::historyLoaded);
+    connect(clientCore, &ClientCore::historyRangeSig, this, &ClientWindow::historyRange);
     // connect for send message
     connect(ui->sendButton, &QPushButton::clicked, this, &ClientWindow::sendMessage);
     connect(ui->messageEdit, &QLineEdit::returnPressed, this, &ClientWindow::sendMessage);
+    // connect for attachments
+    connect(ui->attachButton, &QPushButton::clicked, this, &ClientWindow::attachClicked);
+    connect(ui->chatView, &QListView::doubleClicked, this, &ClientWindow::chatDoubleClicked);
+    connect(clientCore, &ClientCore::uploadFailedSig, this, &ClientWindow::uploadFailed);
+    connect(clientCore, &ClientCore::downloadFinishedSig, this, &ClientWindow::downloadFinished);
+    connect(clientCore, &ClientCore::slowDownSig, this, &ClientWindow::slowDown);
     // connect for login
     connect(loginWindow, &Login::signInSig, this, &ClientWindow::signInClicked);
     connect(loginWindow, &Login::signUpSig, this, &ClientWindow::loginSignUpClicked);
@@ -57,6 +78,10 @@ ClientWindow::ClientWindow(QWidget* parent)
     connect(createGroupWindow, &CreateGroup::createGroupSig, this, &ClientWindow::createGroupWindowClicked);
     // connect for connect to group
     connect(ui->connectGroup, &QPushButton::clicked, this, &ClientWindow::connectGroupClicked);
+    // connect for search
+    connect(ui->searchGroup, &QPushButton::clicked, this, &ClientWindow::searchGroupClicked);
+    connect(searchWindow, &SearchResults::searchSig, clientCore, &ClientCore::search);
+    connect(clientCore, &ClientCore::searchResultsSig, searchWindow, &SearchResults::showResults);
 
     // try connect
     QTimer::singleShot(100, this, [this]() { this->attemptConnection(); });
@@ -66,11 +91,11 @@ ClientWindow::~ClientWindow()
 {
     delete ui;
     delete clientCore;
-    delete chatModel;
     delete loadingScreen;
     delete loginWindow;
     delete registerWindow;
     delete createGroupWindow;
+    delete searchWindow;
 }
 
 QPair<QString, QString> ClientWindow::getConnectionCredentials()
@@ -128,7 +153,6 @@ void ClientWindow::loggedIn()
     enableUi();
 
     // update for logged state
-    lastUserName.clear();
     logged = true;
 
     // close login window
@@ -153,120 +177,109 @@ void ClientWindow::registerError(const QString& reason)
     QMessageBox::critical(this, tr("Error"), reason);
 }
 
-void ClientWindow::connectGroupError(const QString& reason)
+void ClientWindow::connectGroupError(const QString& groupName, const QString& reason)
 {
+    removeGroup(groupName);
     QMessageBox::critical(this, tr("Error"), reason);
 }
 
-QStringList ClientWindow::splitString(const QString& str, const int rowSize)
-{
-    QString temp = str;
-    QStringList list;
-    list.reserve(temp.size() / rowSize + 1);
-
-    while (!temp.isEmpty()) {
-        list.append(temp.left(rowSize).trimmed());
-        temp.remove(0, rowSize);
-    }
-    return list;
-}
-
-QStringList ClientWindow::splitText(const QString& text)
-{
-    const QStringList words = text.split(QRegExp("[\r\n\t ]+"), QString::SkipEmptyParts);
-    const int wordsCount    = words.size();
-    QStringList rows;
-    rows.append("");
-    for (int i = 0, j = 0; i < wordsCount; ++i) {
-        if (words[i].size() > maxMessageRowSize - rows[j].size()) {
-            if (words[i].size() > maxMessageRowSize) {
-                QStringList bigWords = splitString(words[i], maxMessageRowSize);
-                for (const auto& bigWord : bigWords) {
-                    if (rows[j].isEmpty()) {
-                        rows[j] += bigWord + QString(" ");
-                    }
-                    rows.append(bigWord + QString(" "));
-                    ++j;
-                }
-            } else {
-                rows.append(words[i] + QString(" "));
-                ++j;
-            }
-        } else {
-            rows[j] += words[i] + QString(" ");
-        }
-    }
-    return rows;
-}
-
-void ClientWindow::displayMessage(const QString& message, const QString& time, const int lastRowNumber,
-                                  const int alignMask)
+void ClientWindow::messagesReceived(const QList<Message>& messages)
 {
-    QStringList rows    = splitText(message);
-    const int rowsCount = rows.size();
-    int currentRow      = lastRowNumber;
-    for (int i = 0; i < rowsCount; ++i) {
-        chatModel->insertRow(currentRow);
-        if (i == rowsCount - 1) {
-            chatModel->setData(chatModel->index(currentRow, 0), rows[i] + QString(" (") + time + QString(")"));
-        } else {
-            chatModel->setData(chatModel->index(currentRow, 0), rows[i]);
+    // one model update per group for the whole batch
+    QHash<QString, QList<Message>> byGroup;
+    for (const Message& message : messages) {
+        // a group jumping to a date gets newer messages with the pages that follow
+        if (chatModels.contains(message.getGroupName()) && !historyJumps.contains(message.getGroupName())) {
+            byGroup[message.getGroupName()].push_back(message);
         }
-        chatModel->setData(chatModel->index(currentRow, 0), int(alignMask | Qt::AlignVCenter), Qt::TextAlignmentRole);
+    }
+    for (auto it = byGroup.cbegin(); it != byGroup.cend(); ++it) {
+        chatModels.value(it.key())->appendMessages(it.value(), clientCore->getName());
+    }
+    if (byGroup.contains(activeGroup)) {
         ui->chatView->scrollToBottom();
-        ++currentRow;
     }
 }
 
-void ClientWindow::messageReceived(const Message& message)
+void ClientWindow::sendMessage()
 {
-    int currentRow = chatModel->rowCount();
-    if (lastUserName != message.getSender() && clientCore->getName() != message.getSender()) {
-        lastUserName = message.getSender();
+    const QString message = ui->messageEdit->text();
+    if (activeGroup.isEmpty() || message.isEmpty() || message.size() > maxMessageSize) {
+        return;
+    }
+    const QString time = QDateTime::currentDateTime().toString("hh:mm");
+    clientCore->sendMessage(activeGroup, message, time);
+    groupModel(activeGroup)->appendMessage({activeGroup, clientCore->getName(), message, time}, clientCore->getName());
 
-        QFont boldFont;
-        boldFont.setBold(true);
+    ui->messageEdit->clear();
+    ui->chatView->scrollToBottom();
+}
 
-        chatModel->insertRow(currentRow);
-        chatModel->setData(chatModel->index(currentRow, 0), message.getSender());
-        chatModel->setData(chatModel->index(currentRow, 0), int(Qt::AlignLeft | Qt::AlignVCenter),
-                           Qt::TextAlignmentRole);
-        chatModel->setData(chatModel->index(currentRow, 0), boldFont, Qt::FontRole);
-        ++currentRow;
+void ClientWindow::attachClicked()
+{
+    const QString groupName = activeGroup;
+    if (groupName.isEmpty()) {
+        return;
     }
-    if (clientCore->getName() == message.getSender()) {
-        displayMessage(message.getMessage(), message.getTime(), currentRow, Qt::AlignRight);
-    } else {
-        displayMessage(message.getMessage(), message.getTime(), currentRow, Qt::AlignLeft);
+    const QString path = QFileDialog::getOpenFileName(this, tr("Attach File"));
+    if (path.isEmpty() || !chatModels.contains(groupName)) {
+        return;
     }
+    clientCore->sendFile(groupName, path);
+    groupModel(groupName)->appendEvent(tr("sending %1").arg(QFileInfo(path).fileName()));
+    ui->chatView->scrollToBottom();
 }
 
-void ClientWindow::sendMessage()
+void ClientWindow::chatDoubleClicked(const QModelIndex& index)
 {
-    const QString message = ui->messageEdit->text();
-    if (message.isEmpty() || message.size() > maxMessageSize) {
+    const QString groupName = activeGroup;
+    if (groupName.isEmpty() || !index.isValid()) {
         return;
     }
-    const QString time = QDateTime::currentDateTime().toString("hh:mm");
-    clientCore->sendMessage(message, time);
+    const ChatEntry chatEntry = groupModel(groupName)->entry(index.row());
+    if (chatEntry.attachment.isEmpty()) {
+        return;
+    }
+    const QString path = QFileDialog::getSaveFileName(this, tr("Save File"), chatEntry.text);
+    if (!path.isEmpty()) {
+        clientCore->downloadFile(groupName, chatEntry.attachment, path);
+    }
+}
 
-    int currentRow = chatModel->rowCount();
-    displayMessage(message, time, currentRow, Qt::AlignRight);
+void ClientWindow::uploadFailed(const QString& groupName, const QString& fileName, const QString& reason)
+{
+    if (chatModels.contains(groupName)) {
+        groupModel(groupName)->appendEvent(tr("%1 was not sent: %2").arg(fileName, reason));
+    }
+}
 
-    ui->messageEdit->clear();
-    ui->chatView->scrollToBottom();
-    lastUserName.clear();
+void ClientWindow::downloadFinished(const QString& groupName, const QString& path, const bool success)
+{
+    if (!chatModels.contains(groupName)) {
+        return;
+    }
+    const QString fileName = QFileInfo(path).fileName();
+    groupModel(groupName)->appendEvent(success ? tr("%1 saved").arg(fileName)
+                                               : tr("%1 could not be downloaded").arg(fileName));
+}
+
+void ClientWindow::slowDown(const QString& groupName, const int retryAfter)
+{
+    if (chatModels.contains(groupName)) {
+        const int seconds = qMax((retryAfter + 999) / 1000, 1);
+        groupModel(groupName)->appendEvent(
+            tr("sending too fast, a message was not delivered, wait %n second(s)", nullptr, seconds));
+    }
 }
 
 void ClientWindow::disconnected()
 {
     qWarning() << "The host terminated the connection";
 
+    setWindowTitle(defaultTitle);
     disableUi();
-    lastUserName.clear();
     logged = false;
-    chatModel->removeRows(0, chatModel->rowCount());
-    ui->users->clear();
+    clearGroups();
     disconnect(loginWindow, &Login::closeSig, this, &QWidget::close);
     loginWindow->close();
     registerWindow->close();
@@ -275,45 +288,242 @@ void ClientWindow::disconnected()
     }
 }
 
-void ClientWindow::userEventImpl(const QString& username, const QString& event)
+void ClientWindow::reconnecting(const int attempt, const int delay)
 {
-    const int newRow = chatModel->rowCount();
-    chatModel->insertRow(newRow);
-    chatModel->setData(chatModel->index(newRow, 0), tr("%1 %2").arg(username, event));
-    chatModel->setData(chatModel->index(newRow, 0), Qt::AlignCenter, Qt::TextAlignmentRole);
-    chatModel->setData(chatModel->index(newRow, 0), QBrush(Qt::gray), Qt::ForegroundRole);
+    qInfo() << qPrintable(QString("connection lost, attempt %1 in %2 ms").arg(attempt).arg(delay));
+    setWindowTitle(tr("%1 (reconnecting...)").arg(defaultTitle));
+}
 
-    ui->chatView->scrollToBottom();
-    lastUserName.clear();
+void ClientWindow::reconnected()
+{
+    setWindowTitle(defaultTitle);
+}
+
+void ClientWindow::userEventImpl(const QString& groupName, const QStringList& usernames, const QString& event)
+{
+    ChatModel* const model = chatModels.value(groupName);
+    if (!model || usernames.isEmpty()) {
+        return;
+    }
+    // a storm of joins is one line in the chat, not thousands
+    if (usernames.size() == 1) {
+        model->appendEvent(tr("%1 %2").arg(usernames.first(), event));
+    } else {
+        model->appendEvent(tr("%1 users %2").arg(usernames.size()).arg(event));
+    }
+    if (groupName == activeGroup) {
+        ui->chatView->scrollToBottom();
+    }
+}
+
+void ClientWindow::presenceChanged(const QString& groupName, const QStringList& joined, const QStringList& left)
+{
+    if (!logged || !chatModels.contains(groupName)) {
+        return;
+    }
+    QSet<QString>& users = groupUsers[groupName];
+    QStringList newlyJoined;
+    for (const QString& username : joined) {
+        if (!users.contains(username)) {
+            users.insert(username);
+            newlyJoined.push_back(username);
+        }
+    }
+    QStringList reallyLeft;
+    for (const QString& username : left) {
+        if (users.remove(username)) {
+            reallyLeft.push_back(username);
+        }
+    }
+    userEventImpl(groupName, newlyJoined, "joined the group");
+    userEventImpl(groupName, reallyLeft, "left the group");
+    if (groupName == activeGroup && (!newlyJoined.isEmpty() || !reallyLeft.isEmpty())) {
+        showUsers(groupName);
+    }
+}
+
+void ClientWindow::showUsers(const QString& groupName)
+{
+    QStringList usernames = groupUsers.value(groupName).values();
+    usernames.sort();
+    ui->users->setUpdatesEnabled(false);
+    ui->users->clear();
+    ui->users->addItems(usernames);
+    ui->users->setUpdatesEnabled(true);
+}
+
+void ClientWindow::informJoiner(const QString& groupName, const QStringList& usernames,
+                                const QList<Message>& messages)
+{
+    QSet<QString>& users = groupUsers[groupName];
+    users.clear();
+    for (const QString& username : usernames) {
+        users.insert(username);
+    }
+    groupModel(groupName)->setHistory(messages, clientCore->getName(), historyPageSize);
+    if (groupName == activeGroup) {
+        showUsers(groupName);
+        ui->chatView->scrollToBottom();
+    }
+}
+
+void ClientWindow::chatScrolled(const int value)
+{
+    ChatModel* const model = chatModels.value(activeGroup);
+    if (!model || value != ui->chatView->verticalScrollBar()->minimum() || !model->canLoadOlder()) {
+        return;
+    }
+    // keep the row that was on top in place while older rows appear above it
+    const int loaded = model->loadOlder(historyPageSize);
+    ui->chatView->scrollTo(model->index(loaded, 0), QAbstractItemView::PositionAtTop);
+}
+
+void ClientWindow::historyLoaded(const QString& groupName, const QList<Message>& messages)
+{
+    // a rejoin brings the whole history back, a jump that was under way is over
+    historyJumps.remove(groupName);
+    groupModel(groupName)->setHistory(messages, clientCore->getName(), historyPageSize);
+    // rejoins after a reconnect must not steal the focus
+    if (!clientCore->isReconnecting()) {
+        showGroup(groupName);
+    } else if (groupName == activeGroup) {
+        ui->chatView->scrollToBottom();
+    }
+}
+
+ChatModel* ClientWindow::groupModel(const QString& groupName)
+{
+    ChatModel*& model = chatModels[groupName];
+    if (!model) {
+        model = new ChatModel(this);
+        ui->groups->addItem(groupName);
+    }
+    return model;
 }
 
-void ClientWindow::userJoined(const QString& username)
+void ClientWindow::showGroup(const QString& groupName)
 {
-    if (logged) {
-        userEventImpl(username, "joined the group");
-        ui->users->addItem(username);
+    activeGroup = groupName;
+    ui->chatView->setModel(groupModel(groupName));
+    showUsers(groupName);
+
+    const QList<QListWidgetItem*> items = ui->groups->findItems(groupName, Qt::MatchExactly);
+    if (!items.isEmpty() && ui->groups->currentItem() != items.at(0)) {
+        ui->groups->setCurrentItem(items.at(0));
     }
+    ui->chatView->scrollToBottom();
 }
 
-void ClientWindow::userLeft(const QString& username)
+void ClientWindow::removeGroup(const QString& groupName)
 {
-    userEventImpl(username, "left the group");
-    QList<QListWidgetItem*> items = ui->users->findItems(username, Qt::MatchExactly);
-    if (items.isEmpty()) {
+    delete chatModels.take(groupName);
+    groupUsers.remove(groupName);
+    historyJumps.remove(groupName);
+    if (searchWindow->getGroupName() == groupName) {
+        searchWindow->close();
+    }
+    const QList<QListWidgetItem*> items = ui->groups->findItems(groupName, Qt::MatchExactly);
+    if (!items.isEmpty()) {
+        delete items.at(0);
+    }
+    if (groupName != activeGroup) {
         return;
     }
-    delete items.at(0);
+    activeGroup.clear();
+    ui->chatView->setModel(nullptr);
+    ui->users->clear();
+    if (ui->groups->count() > 0) {
+        showGroup(ui->groups->item(0)->text());
+        return;
+    }
+    ui->sendButton->setEnabled(false);
+    ui->attachButton->setEnabled(false);
+    ui->messageEdit->setEnabled(false);
+    ui->chatView->setEnabled(false);
+    ui->searchGroup->setEnabled(false);
 }
 
-void ClientWindow::informJoiner(const QStringList& usernames, const QList<Message>& messages)
+void ClientWindow::clearGroups()
 {
-    chatModel->removeRows(0, chatModel->rowCount());
+    activeGroup.clear();
+    ui->chatView->setModel(nullptr);
+    qDeleteAll(chatModels);
+    chatModels.clear();
+    groupUsers.clear();
+    historyJumps.clear();
+    ui->groups->clear();
     ui->users->clear();
-    for (const auto& username : usernames) {
-        ui->users->addItem(username);
+}
+
+void ClientWindow::groupSelected(const QString& groupName)
+{
+    if (!groupName.isEmpty() && groupName != activeGroup) {
+        showGroup(groupName);
     }
-    for (const auto& message : messages) {
-        messageReceived(message);
+}
+
+void ClientWindow::groupsContextMenu(const QPoint& pos)
+{
+    const QListWidgetItem* const item = ui->groups->itemAt(pos);
+    if (!item) {
+        return;
+    }
+    const QString groupName = item->text();
+    QMenu menu(this);
+    const QAction* const jumpAction  = menu.addAction(tr("jump to date"));
+    const QAction* const leaveAction = menu.addAction(tr("leave group"));
+    const QAction* const chosen      = menu.exec(ui->groups->mapToGlobal(pos));
+    if (chosen == jumpAction) {
+        jumpToDate(groupName);
+    } else if (chosen == leaveAction) {
+        clientCore->leaveGroup(groupName);
+        removeGroup(groupName);
+    }
+}
+
+void ClientWindow::jumpToDate(const QString& groupName)
+{
+    QDialog dialog(this);
+    dialog.setWindowFlags(dialog.windowFlags() & ~Qt::WindowContextHelpButtonHint & ~Qt::WindowMaximizeButtonHint);
+    dialog.setWindowTitle("Jump To Date");
+    QFormLayout form(&dialog);
+
+    QDateEdit dateEdit(QDate::currentDate(), &dialog);
+    dateEdit.setCalendarPopup(true);
+    dateEdit.setMaximumDate(QDate::currentDate());
+    form.addRow(tr("show messages since"), &dateEdit);
+
+    QDialogButtonBox buttonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, Qt::Horizontal, &dialog);
+    form.addRow(&buttonBox);
+
+    connect(&buttonBox, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(&buttonBox, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    connect(clientCore, &ClientCore::disconnectedSig, &dialog, &QDialog::close);
+    if (dialog.exec() != QDialog::Accepted || !chatModels.contains(groupName)) {
+        return;
+    }
+
+    historyJumps.insert(groupName);
+    groupModel(groupName)->clear();
+    showGroup(groupName);
+    clientCore->requestHistory(groupName, QDateTime(dateEdit.date()).toMSecsSinceEpoch());
+}
+
+void ClientWindow::historyRange(const QString& groupName, const QList<Message>& messages, const bool hasMore)
+{
+    if (!historyJumps.contains(groupName) || !chatModels.contains(groupName)) {
+        return;
+    }
+    ChatModel* const model = chatModels.value(groupName);
+    model->appendMessages(messages, clientCore->getName());
+    // pages run up to now, the next one starts after the last message of this one
+    if (hasMore && !messages.isEmpty()) {
+        clientCore->requestHistory(groupName, messages.last().getTimestamp(), 0, messages.last().getId());
+        return;
+    }
+    historyJumps.remove(groupName);
+    if (groupName == activeGroup) {
+        ui->chatView->scrollToTop();
     }
 }
 
@@ -395,10 +605,8 @@ void ClientWindow::error(const QAbstractSocket::SocketError socketError)
 
     disableUi();
 
-    lastUserName.clear();
     logged = false;
-    chatModel->removeRows(0, chatModel->rowCount());
-    ui->users->clear();
+    clearGroups();
     disconnect(loginWindow, &Login::closeSig, this, &QWidget::close);
     loginWindow->close();
     registerWindow->close();
@@ -464,11 +672,23 @@ void ClientWindow::connectGroupClicked()
     attemptConnectGroup(name, "temp");
 }
 
-void ClientWindow::connectedToGroup()
+void ClientWindow::connectedToGroup(const QString& groupName)
 {
+    if (!clientCore->isReconnecting()) {
+        showGroup(groupName);
+    }
     ui->sendButton->setEnabled(true);
+    ui->attachButton->setEnabled(true);
     ui->messageEdit->setEnabled(true);
     ui->chatView->setEnabled(true);
+    ui->searchGroup->setEnabled(true);
+}
+
+void ClientWindow::searchGroupClicked()
+{
+    if (!activeGroup.isEmpty()) {
+        searchWindow->openGroup(activeGroup);
+    }
 }
 
 void ClientWindow::enableUi()
@@ -481,11 +701,14 @@ void ClientWindow::enableUi()
 void ClientWindow::disableUi()
 {
     ui->sendButton->setEnabled(false);
+    ui->attachButton->setEnabled(false);
     ui->messageEdit->setEnabled(false);
     ui->chatView->setEnabled(false);
     ui->createGroup->setEnabled(false);
     ui->connectGroup->setEnabled(false);
     ui->groupSettings->setEnabled(false);
+    ui->searchGroup->setEnabled(false);
+    searchWindow->close();
 }
 
 void ClientWindow::attemptCreateGroup(const QString& groupName, const QString& password)
@@ -3,13 +3,16 @@
 
 #include <QWidget>
 #include <QAbstractSocket>
-#include <QStandardItemModel>
+#include <QHash>
+#include <QSet>
 #include "login.h"
 #include "register.h"
 #include "clientcore.h"
 #include "loadingscreen.h"
 #include "creategroup.h"
+#include "searchresults.h"
 #include "message.h"
+#include "chatmodel.h"
 
 namespace Ui {
     class ClientWindow;
@@ -26,33 +29,45 @@ public:
 private:
     Ui::ClientWindow* ui;
     ClientCore* clientCore;
-    QStandardItemModel* chatModel;
-    QString lastUserName;
+    QHash<QString, ChatModel*> chatModels;
+    QHash<QString, QSet<QString>> groupUsers;
+    QString activeGroup;
+    QSet<QString> historyJumps; // groups showing history from a date while its pages arrive
     Login* loginWindow;
     Register* registerWindow;
     CreateGroup* createGroupWindow;
+    SearchResults* searchWindow;
     LoadingScreen* loadingScreen;
     bool logged;
+    QString defaultTitle;
     static constexpr int minWindowWidth    = 750;
     static constexpr int minWindowHeight   = 500;
-    static constexpr int maxMessageRowSize = 50;
     static constexpr int maxMessageSize    = 2048;
+    static constexpr int historyPageSize   = 100;
 private slots:
     void connected();
     void loggedIn();
     void registered();
-    void connectedToGroup();
+    void connectedToGroup(const QString& groupName);
     void createdGroup();
     void loginError(const QString& reason);
     void registerError(const QString& reason);
-    void connectGroupError(const QString& reason);
+    void connectGroupError(const QString& groupName, const QString& reason);
     void createdGroupError(const QString& reason);
-    void messageReceived(const Message& message);
+    void messagesReceived(const QList<Message>& messages);
     void sendMessage();
+    void attachClicked();
+    void chatDoubleClicked(const QModelIndex& index);
+    void uploadFailed(const QString& groupName, const QString& fileName, const QString& reason);
+    void downloadFinished(const QString& groupName, const QString& path, bool success);
+    void slowDown(const QString& groupName, int retryAfter);
     void disconnected();
-    void userJoined(const QString& username);
-    void userLeft(const QString& username);
-    void informJoiner(const QStringList& usernames, const QList<Message>& messages);
+    void reconnecting(int attempt, int delay);
+    void reconnected();
+    void presenceChanged(const QString& groupName, const QStringList& joined, const QStringList& left);
+    void informJoiner(const QString& groupName, const QStringList& usernames, const QList<Message>& messages);
+    void historyLoaded(const QString& groupName, const QList<Message>& messages);
+    void historyRange(const QString& groupName, const QList<Message>& messages, bool hasMore);
     void error(QAbstractSocket::SocketError socketError);
     void signInClicked();
     void loginSignUpClicked();
@@ -60,6 +75,10 @@ private slots:
     void createGroupClicked();
     void createGroupWindowClicked();
     void connectGroupClicked();
+    void searchGroupClicked();
+    void chatScrolled(int value);
+    void groupSelected(const QString& groupName);
+    void groupsContextMenu(const QPoint& pos);
 
 private:
     static QString encryptPassword(const QString& password);
@@ -70,12 +89,15 @@ private:
     void attemptCreateGroup(const QString& groupName, const QString& password);
     void enableUi();
     void disableUi();
+    ChatModel* groupModel(const QString& groupName);
+    void showGroup(const QString& groupName);
+    void removeGroup(const QString& groupName);
+    void clearGroups();
+    void showUsers(const QString& groupName);
+    void jumpToDate(const QString& groupName);
 
     QPair<QString, QString> getConnectionCredentials();
-    static QStringList splitString(const QString& str, int rowSize);
-    static QStringList splitText(const QString& text);
-    void displayMessage(const QString& message, const QString& time, int lastRowNumber, int alignMask);
-    void userEventImpl(const QString& username, const QString& event);
+    void userEventImpl(const QString& groupName, const QStringList& usernames, const QString& event);
 };
 
 #endif // CLIENT_WINDOW_H
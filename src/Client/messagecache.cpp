@@ -0,0 +1,106 @@
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QStandardPaths>
+#include "messagecache.h"
+#include "constants.h"
+
+MessageCache::MessageCache(const QString& server, const QString& groupName, const QString& epoch)
+    : groupName(groupName), epoch(epoch), lastId(0)
+{
+    const QString directory = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) +
+                              QString("/cache/") + QString::fromLatin1(server.toUtf8().toHex());
+    QDir().mkpath(directory);
+    file.setFileName(directory + QString("/") + QString::fromLatin1(groupName.toUtf8().toHex()) + QString(".log"));
+}
+
+MessageCache::~MessageCache()
+{
+    file.close();
+}
+
+const QString& MessageCache::getGroupName() const
+{
+    return groupName;
+}
+
+qint64 MessageCache::getLastId() const
+{
+    return lastId;
+}
+
+bool MessageCache::writeHeader()
+{
+    file.resize(0);
+    file.seek(0);
+    QDataStream stream(&file);
+    stream.setVersion(SERIALIZER_VERSION);
+    stream << magic << version << epoch;
+    return stream.status() == QDataStream::Ok;
+}
+
+QList<Message> MessageCache::load()
+{
+    QList<Message> messages;
+    lastId = 0;
+    if (!file.open(QIODevice::ReadWrite)) {
+        qWarning() << file.errorString();
+        return messages;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(SERIALIZER_VERSION);
+    quint32 fileMagic   = 0;
+    quint16 fileVersion = 0;
+    QString fileEpoch;
+    stream >> fileMagic >> fileVersion >> fileEpoch;
+    // the server started its ids over, what is cached belongs to other messages
+    if (stream.status() != QDataStream::Ok || fileMagic != magic || fileVersion != version || fileEpoch != epoch) {
+        writeHeader();
+        return messages;
+    }
+
+    qint64 validSize = file.pos();
+    while (!stream.atEnd()) {
+        qint64 id = 0;
+        QString sender;
+        QString text;
+        QString time;
+        qint64 timestamp = 0;
+        QString attachment;
+        qint64 attachmentSize = 0;
+        stream >> id >> sender >> text >> time >> timestamp >> attachment >> attachmentSize;
+        if (stream.status() != QDataStream::Ok) {
+            break;
+        }
+        validSize = file.pos();
+        lastId    = qMax(lastId, id);
+        Message message(groupName, sender, text, time, id, timestamp);
+        message.setAttachment(attachment, attachmentSize);
+        messages.push_back(message);
+    }
+    // drop a record torn by a crash in the middle of a write
+    if (validSize != file.size()) {
+        file.resize(validSize);
+    }
+    file.seek(file.size());
+    return messages;
+}
+
+void MessageCache::append(const QList<Message>& messages)
+{
+    if (!file.isOpen()) {
+        return;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(SERIALIZER_VERSION);
+    for (const auto& message : messages) {
+        if (message.getId() <= lastId) {
+            continue;
+        }
+        stream << message.getId() << message.getSender() << message.getMessage().toString() << message.getTime()
+               << message.getTimestamp() << message.getAttachment().toString() << message.getAttachmentSize();
+        lastId = message.getId();
+    }
+    file.flush();
+}
@@ -0,0 +1,31 @@
+#ifndef MESSAGE_CACHE_H
+#define MESSAGE_CACHE_H
+
+#include <QFile>
+#include <QList>
+#include "message.h"
+
+/* append-only on-disk history of one group on one server, written for one epoch of its message ids */
+class MessageCache
+{
+public:
+    MessageCache(const QString& server, const QString& groupName, const QString& epoch);
+    ~MessageCache();
+    [[nodiscard]] const QString& getGroupName() const;
+    [[nodiscard]] qint64 getLastId() const;
+    QList<Message> load();
+    void append(const QList<Message>& messages);
+
+private:
+    bool writeHeader();
+
+private:
+    QString groupName;
+    QString epoch;
+    QFile file;
+    qint64 lastId;
+    static constexpr quint32 magic   = 0x4d534743; // MSGC
+    static constexpr quint16 version = 4; // 2 - server timestamps, 3 - attachments, 4 - epoch
+};
+
+#endif // MESSAGE_CACHE_H
@@ -0,0 +1,79 @@
+#include <QDateTime>
+#include "searchresults.h"
+#include "ui_searchresults.h"
+
+SearchResults::SearchResults(QWidget* parent) : QWidget(parent), ui(new Ui::SearchResults), oldestId(0)
+{
+    ui->setupUi(this);
+    ui->queryLine->setMaxLength(maxQuerySize);
+
+    connect(ui->searchButton, &QPushButton::clicked, this, &SearchResults::searchClicked);
+    connect(ui->queryLine, &QLineEdit::returnPressed, this, &SearchResults::searchClicked);
+    connect(ui->moreButton, &QPushButton::clicked, this, &SearchResults::moreClicked);
+}
+
+SearchResults::~SearchResults()
+{
+    delete ui;
+}
+
+void SearchResults::openGroup(const QString& groupName)
+{
+    if (groupName != this->groupName) {
+        this->groupName = groupName;
+        query.clear();
+        oldestId = 0;
+        ui->queryLine->clear();
+        ui->hits->clear();
+        ui->moreButton->setEnabled(false);
+    }
+    setWindowTitle(tr("Search in %1").arg(groupName));
+    show();
+    raise();
+    activateWindow();
+    ui->queryLine->setFocus();
+}
+
+QString SearchResults::getGroupName() const
+{
+    return groupName;
+}
+
+void SearchResults::searchClicked()
+{
+    const QString text = ui->queryLine->text().simplified();
+    if (text.isEmpty() || groupName.isEmpty()) {
+        return;
+    }
+    query    = text;
+    oldestId = 0;
+    ui->hits->clear();
+    ui->moreButton->setEnabled(false);
+    emit searchSig(groupName, query, 0);
+}
+
+void SearchResults::moreClicked()
+{
+    ui->moreButton->setEnabled(false);
+    emit searchSig(groupName, query, oldestId);
+}
+
+void SearchResults::showResults(const QString& groupName, const QString& query, const QList<Message>& hits,
+                                const bool hasMore)
+{
+    // answers to an older query or another group are stale
+    if (groupName != this->groupName || query != this->query) {
+        return;
+    }
+    for (const Message& hit : hits) {
+        const QString time = hit.getTimestamp() != 0
+                                 ? QDateTime::fromMSecsSinceEpoch(hit.getTimestamp()).toString("yyyy-MM-dd hh:mm")
+                                 : hit.getTime();
+        ui->hits->addItem(QString("[%1] %2: %3").arg(time, hit.getSender(), hit.getMessage().toString()));
+        oldestId = oldestId == 0 ? hit.getId() : qMin(oldestId, hit.getId());
+    }
+    if (ui->hits->count() == 0) {
+        ui->hits->addItem(tr("nothing found"));
+    }
+    ui->moreButton->setEnabled(hasMore && oldestId > 0);
+}
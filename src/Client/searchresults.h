@@ -0,0 +1,42 @@
+#ifndef SEARCH_RESULTS_H
+#define SEARCH_RESULTS_H
+
+#include <QWidget>
+#include "message.h"
+
+QT_BEGIN_NAMESPACE
+namespace Ui {
+    class SearchResults;
+}
+QT_END_NAMESPACE
+
+/* search window of one group, asks for older pages until the server has no more hits */
+class SearchResults : public QWidget
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(SearchResults)
+public:
+    explicit SearchResults(QWidget* parent = nullptr);
+    ~SearchResults() override;
+    void openGroup(const QString& groupName);
+    [[nodiscard]] QString getGroupName() const;
+
+public slots:
+    void showResults(const QString& groupName, const QString& query, const QList<Message>& hits, bool hasMore);
+
+private slots:
+    void searchClicked();
+    void moreClicked();
+
+signals:
+    void searchSig(const QString& groupName, const QString& query, qint64 beforeId);
+
+private:
+    Ui::SearchResults* ui;
+    QString groupName;
+    QString query;
+    qint64 oldestId;
+    static constexpr int maxQuerySize = 256;
+};
+
+#endif // SEARCH_RESULTS_H
@@ -0,0 +1,88 @@
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QRunnable>
+#include <QTimer>
+#include "authpool.h"
+#include "credentials.h"
+#include "metrics.h"
+
+namespace {
+    class AuthTask : public QRunnable
+    {
+    public:
+        explicit AuthTask(std::function<void()> task) : task(std::move(task)) {}
+        void run() override
+        {
+            task();
+        }
+
+    private:
+        std::function<void()> task;
+    };
+} // namespace
+
+AuthPool::AuthPool(const int threadCount, const int maxQueueDepth, const int hashIterations, QObject* parent)
+    : QObject(parent), pending(0), maxQueueDepth(maxQueueDepth), hashIterations(hashIterations)
+{
+    pool.setMaxThreadCount(qMax(threadCount, 1));
+    pool.setExpiryTimeout(-1);
+}
+
+AuthPool::~AuthPool()
+{
+    pool.clear();
+    pool.waitForDone();
+}
+
+int AuthPool::queueDepth() const
+{
+    return pending.load();
+}
+
+bool AuthPool::submit(const std::function<void()>& task)
+{
+    if (pending.fetch_add(1) >= maxQueueDepth) {
+        pending.fetch_sub(1);
+        Metrics::increment("auth.rejected");
+        return false;
+    }
+    Metrics::increment("auth.submitted");
+    Metrics::set("auth.queue_depth", pending.load());
+
+    QElapsedTimer queued;
+    queued.start();
+    pool.start(new AuthTask([this, task, queued] {
+        Metrics::increment("auth.wait_us", queued.nsecsElapsed() / 1000);
+        QElapsedTimer busy;
+        busy.start();
+        task();
+        Metrics::increment("auth.busy_us", busy.nsecsElapsed() / 1000);
+        Metrics::increment("auth.completed");
+        Metrics::set("auth.queue_depth", pending.fetch_sub(1) - 1);
+    }));
+    return true;
+}
+
+bool AuthPool::hash(const QString& password, QObject* const context, const std::function<void(const QString&)>& done)
+{
+    QPointer<QObject> receiver(context);
+    const int iterations = hashIterations;
+    return submit([password, receiver, done, iterations] {
+        const QString hashed = credentials::hash(password, iterations);
+        if (receiver) {
+            QTimer::singleShot(0, receiver.data(), [done, hashed] { done(hashed); });
+        }
+    });
+}
+
+bool AuthPool::verify(const QString& password, const QString& stored, QObject* const context,
+                      const std::function<void(bool)>& done)
+{
+    QPointer<QObject> receiver(context);
+    return submit([password, stored, receiver, done] {
+        const bool valid = credentials::verify(password, stored);
+        if (receiver) {
+            QTimer::singleShot(0, receiver.data(), [done, valid] { done(valid); });
+        }
+    });
+}
@@ -0,0 +1,33 @@
+#ifndef AUTH_POOL_H
+#define AUTH_POOL_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <atomic>
+#include <functional>
+
+/* bounded pool for CPU-heavy credential work, keeps password hashing off the ServerCore thread */
+class AuthPool : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(AuthPool)
+public:
+    AuthPool(int threadCount, int maxQueueDepth, int hashIterations, QObject* parent = nullptr);
+    ~AuthPool() override;
+
+    bool hash(const QString& password, QObject* context, const std::function<void(const QString&)>& done);
+    bool verify(const QString& password, const QString& stored, QObject* context,
+                const std::function<void(bool)>& done);
+    [[nodiscard]] int queueDepth() const;
+
+private:
+    bool submit(const std::function<void()>& task);
+
+private:
+    QThreadPool pool;
+    std::atomic<int> pending;
+    const int maxQueueDepth;
+    const int hashIterations;
+};
+
+#endif // AUTH_POOL_H
@@ -0,0 +1,143 @@
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QHostAddress>
+#include "clusterbroker.h"
+#include "clusterprotocol.h"
+#include "metrics.h"
+
+ClusterBroker::ClusterBroker(QObject* parent) : QObject(parent), tcpServer(nullptr), localServer(nullptr)
+{
+}
+
+bool ClusterBroker::listen(const QString& address)
+{
+    if (address.startsWith(QLatin1String("local:"))) {
+        const QString name = address.mid(6);
+        localServer        = new QLocalServer(this);
+        QLocalServer::removeServer(name);
+        connect(localServer, &QLocalServer::newConnection, this, [this] {
+            while (QLocalSocket* peer = localServer->nextPendingConnection()) {
+                peerConnected(peer);
+            }
+        });
+        return localServer->listen(name);
+    }
+    if (address.startsWith(QLatin1String("tcp:"))) {
+        const QString hostPort = address.mid(4);
+        const int separator    = hostPort.lastIndexOf(':');
+        if (separator <= 0) {
+            return false;
+        }
+        tcpServer = new QTcpServer(this);
+        connect(tcpServer, &QTcpServer::newConnection, this, [this] {
+            while (QTcpSocket* peer = tcpServer->nextPendingConnection()) {
+                peerConnected(peer);
+            }
+        });
+        return tcpServer->listen(QHostAddress(hostPort.left(separator)), hostPort.mid(separator + 1).toUShort());
+    }
+    return false;
+}
+
+template <typename Socket>
+void ClusterBroker::peerConnected(Socket* const peer)
+{
+    nodes.insert(peer, QString());
+    connect(peer, &Socket::readyRead, this, [this, peer] { peerReadyRead(peer); });
+    connect(peer, &Socket::disconnected, this, [this, peer] { peerDisconnected(peer); });
+}
+
+void ClusterBroker::peerReadyRead(QIODevice* const peer)
+{
+    for (const QJsonObject& frame : cluster::readFrames(peer)) {
+        frameReceived(peer, frame);
+    }
+}
+
+void ClusterBroker::peerDisconnected(QIODevice* const peer)
+{
+    const QString node = nodes.take(peer);
+    for (auto it = subscribers.begin(); it != subscribers.end();) {
+        it->remove(peer);
+        it = it->isEmpty() ? subscribers.erase(it) : std::next(it);
+    }
+    peer->deleteLater();
+    if (node.isEmpty()) {
+        return;
+    }
+    qInfo() << qPrintable(QString("cluster node %1 left").arg(node));
+
+    // members of that node are gone for everyone else
+    QJsonObject frame;
+    frame[cluster::Type::TYPE] = cluster::Type::NODE_DOWN;
+    frame[cluster::Data::NODE] = node;
+    for (auto it = nodes.cbegin(); it != nodes.cend(); ++it) {
+        cluster::writeFrame(it.key(), frame);
+    }
+}
+
+void ClusterBroker::frameReceived(QIODevice* const peer, const QJsonObject& frame)
+{
+    const QString groupName = frame.value(QLatin1String(cluster::Data::GROUP)).toString();
+    if (cluster::isEqualType(frame, cluster::Type::HELLO)) {
+        nodes[peer] = frame.value(QLatin1String(cluster::Data::NODE)).toString();
+        qInfo() << qPrintable(QString("cluster node %1 joined").arg(nodes.value(peer)));
+    } else if (nodes.value(peer).isEmpty() || groupName.isEmpty()) {
+        return;
+    } else if (cluster::isEqualType(frame, cluster::Type::SUBSCRIBE)) {
+        subscribe(peer, groupName);
+    } else if (cluster::isEqualType(frame, cluster::Type::UNSUBSCRIBE)) {
+        unsubscribe(peer, groupName);
+    } else if (cluster::isEqualType(frame, cluster::Type::PUBLISH)) {
+        publish(peer, groupName, frame);
+    }
+}
+
+void ClusterBroker::subscribe(QIODevice* const peer, const QString& groupName)
+{
+    QSet<QIODevice*>& groupNodes = subscribers[groupName];
+    if (groupNodes.contains(peer)) {
+        return;
+    }
+    groupNodes.insert(peer);
+
+    // the other nodes answer with their members of the group
+    QJsonObject frame;
+    frame[cluster::Type::TYPE]  = cluster::Type::SYNC;
+    frame[cluster::Data::GROUP] = groupName;
+    frame[cluster::Data::NODE]  = nodes.value(peer);
+    for (QIODevice* const node : groupNodes) {
+        if (node != peer) {
+            cluster::writeFrame(node, frame);
+        }
+    }
+}
+
+void ClusterBroker::unsubscribe(QIODevice* const peer, const QString& groupName)
+{
+    auto groupNodes = subscribers.find(groupName);
+    if (groupNodes == subscribers.end()) {
+        return;
+    }
+    groupNodes->remove(peer);
+    if (groupNodes->isEmpty()) {
+        subscribers.erase(groupNodes);
+    }
+}
+
+void ClusterBroker::publish(QIODevice* const peer, const QString& groupName, const QJsonObject& frame)
+{
+    QJsonObject forwarded          = frame;
+    forwarded[cluster::Data::NODE] = nodes.value(peer);
+    qint64 forwardedCount          = 0;
+    for (QIODevice* const node : subscribers.value(groupName)) {
+        if (node != peer) {
+            cluster::writeFrame(node, forwarded);
+            ++forwardedCount;
+        }
+    }
+    Metrics::increment("cluster.published");
+    Metrics::increment("cluster.forwarded", forwardedCount);
+}
@@ -0,0 +1,39 @@
+#ifndef CLUSTER_BROKER_H
+#define CLUSTER_BROKER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QJsonObject>
+
+class QIODevice;
+class QTcpServer;
+class QLocalServer;
+
+/* routes group traffic between server nodes, a node only receives groups it has members in */
+class ClusterBroker : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(ClusterBroker)
+public:
+    explicit ClusterBroker(QObject* parent = nullptr);
+    bool listen(const QString& address);
+
+private:
+    template <typename Socket>
+    void peerConnected(Socket* peer);
+    void peerReadyRead(QIODevice* peer);
+    void peerDisconnected(QIODevice* peer);
+    void frameReceived(QIODevice* peer, const QJsonObject& frame);
+    void subscribe(QIODevice* peer, const QString& groupName);
+    void unsubscribe(QIODevice* peer, const QString& groupName);
+    void publish(QIODevice* peer, const QString& groupName, const QJsonObject& frame);
+
+private:
+    QTcpServer* tcpServer;
+    QLocalServer* localServer;
+    QHash<QIODevice*, QString> nodes;
+    QHash<QString, QSet<QIODevice*>> subscribers; // group -> nodes with local members
+};
+
+#endif // CLUSTER_BROKER_H
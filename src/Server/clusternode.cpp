@@ -0,0 +1,198 @@
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <QJsonArray>
+#include "clusternode.h"
+#include "clusterprotocol.h"
+#include "constants.h"
+
+ClusterNode::ClusterNode(const QString& brokerAddress, const QString& nodeId, QObject* parent)
+    : QObject(parent), brokerAddress(brokerAddress), nodeId(nodeId), link(nullptr), retryTimer(new QTimer(this)),
+      linked(false)
+{
+    retryTimer->setSingleShot(true);
+    retryTimer->setInterval(retryInterval);
+    connect(retryTimer, &QTimer::timeout, this, &ClusterNode::connectToBroker);
+}
+
+void ClusterNode::start()
+{
+    connectToBroker();
+}
+
+void ClusterNode::connectToBroker()
+{
+    if (link) {
+        link->disconnect(this);
+        link->deleteLater();
+    }
+    link = cluster::connectTo(brokerAddress, this);
+    if (!link) {
+        qCritical() << qPrintable(QString("invalid broker address %1").arg(brokerAddress));
+        return;
+    }
+    connect(link, &QIODevice::readyRead, this, &ClusterNode::onReadyRead);
+    if (auto* socket = qobject_cast<QLocalSocket*>(link)) {
+        connect(socket, &QLocalSocket::connected, this, &ClusterNode::onConnected);
+        connect(socket, &QLocalSocket::disconnected, this, &ClusterNode::onDisconnected);
+        connect(socket, QOverload<QLocalSocket::LocalSocketError>::of(&QLocalSocket::error), this,
+                &ClusterNode::onDisconnected);
+    } else if (auto* socket = qobject_cast<QTcpSocket*>(link)) {
+        connect(socket, &QTcpSocket::connected, this, &ClusterNode::onConnected);
+        connect(socket, &QTcpSocket::disconnected, this, &ClusterNode::onDisconnected);
+        connect(socket, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error), this,
+                &ClusterNode::onDisconnected);
+    }
+}
+
+void ClusterNode::onConnected()
+{
+    linked = true;
+    qInfo() << qPrintable(QString("joined the cluster as %1").arg(nodeId));
+
+    QJsonObject hello;
+    hello[cluster::Type::TYPE] = cluster::Type::HELLO;
+    hello[cluster::Data::NODE] = nodeId;
+    send(hello);
+    // the broker forgets everything about a node once the link drops
+    for (const QString& groupName : groups) {
+        QJsonObject frame;
+        frame[cluster::Type::TYPE]  = cluster::Type::SUBSCRIBE;
+        frame[cluster::Data::GROUP] = groupName;
+        send(frame);
+    }
+}
+
+void ClusterNode::onDisconnected()
+{
+    if (retryTimer->isActive()) {
+        return;
+    }
+    if (linked) {
+        qWarning() << "lost the cluster broker";
+    }
+    linked = false;
+
+    // nobody can vouch for the remote members anymore
+    QSet<QString> nodes;
+    for (const auto& groupNodes : members) {
+        for (auto it = groupNodes.cbegin(); it != groupNodes.cend(); ++it) {
+            nodes.insert(it.key());
+        }
+    }
+    for (const QString& node : nodes) {
+        nodeDown(node);
+    }
+    retryTimer->start();
+}
+
+void ClusterNode::onReadyRead()
+{
+    for (const QJsonObject& frame : cluster::readFrames(link)) {
+        frameReceived(frame);
+    }
+}
+
+void ClusterNode::send(const QJsonObject& frame)
+{
+    if (linked) {
+        cluster::writeFrame(link, frame);
+    }
+}
+
+void ClusterNode::subscribe(const QString& groupName)
+{
+    if (groups.contains(groupName)) {
+        return;
+    }
+    groups.insert(groupName);
+    QJsonObject frame;
+    frame[cluster::Type::TYPE]  = cluster::Type::SUBSCRIBE;
+    frame[cluster::Data::GROUP] = groupName;
+    send(frame);
+}
+
+void ClusterNode::unsubscribe(const QString& groupName)
+{
+    if (!groups.remove(groupName)) {
+        return;
+    }
+    members.remove(groupName);
+    QJsonObject frame;
+    frame[cluster::Type::TYPE]  = cluster::Type::UNSUBSCRIBE;
+    frame[cluster::Data::GROUP] = groupName;
+    send(frame);
+}
+
+void ClusterNode::publish(const QString& groupName, const QJsonObject& packet)
+{
+    QJsonObject frame;
+    frame[cluster::Type::TYPE]   = cluster::Type::PUBLISH;
+    frame[cluster::Data::GROUP]  = groupName;
+    frame[cluster::Data::PACKET] = packet;
+    send(frame);
+}
+
+QStringList ClusterNode::remoteMembers(const QString& groupName) const
+{
+    QStringList userNames;
+    for (const QSet<QString>& nodeMembers : members.value(groupName)) {
+        for (const QString& userName : nodeMembers) {
+            userNames.push_back(userName);
+        }
+    }
+    return userNames;
+}
+
+void ClusterNode::frameReceived(const QJsonObject& frame)
+{
+    const QString node      = frame.value(QLatin1String(cluster::Data::NODE)).toString();
+    const QString groupName = frame.value(QLatin1String(cluster::Data::GROUP)).toString();
+    if (cluster::isEqualType(frame, cluster::Type::NODE_DOWN)) {
+        nodeDown(node);
+        return;
+    }
+    if (!groups.contains(groupName)) {
+        return;
+    }
+    if (cluster::isEqualType(frame, cluster::Type::SYNC)) {
+        emit syncRequestedSig(groupName);
+    } else if (cluster::isEqualType(frame, cluster::Type::PUBLISH)) {
+        const QJsonObject packet = frame.value(QLatin1String(cluster::Data::PACKET)).toObject();
+        const QString type       = packet.value(QLatin1String(Packet::Type::TYPE)).toString();
+        if (type == QLatin1String(Packet::Type::PRESENCE)) {
+            remotePresence(node, groupName, packet);
+        }
+        emit packetReceivedSig(groupName, packet);
+    }
+}
+
+void ClusterNode::remotePresence(const QString& node, const QString& groupName, const QJsonObject& packet)
+{
+    QSet<QString>& nodeMembers = members[groupName][node];
+    for (const auto& userName : packet.value(QLatin1String(Packet::Data::JOINED)).toArray()) {
+        nodeMembers.insert(userName.toString());
+    }
+    for (const auto& userName : packet.value(QLatin1String(Packet::Data::LEFT)).toArray()) {
+        nodeMembers.remove(userName.toString());
+    }
+}
+
+void ClusterNode::nodeDown(const QString& node)
+{
+    for (auto it = members.begin(); it != members.end(); ++it) {
+        const QSet<QString> gone = it->take(node);
+        if (gone.isEmpty()) {
+            continue;
+        }
+        QStringList left;
+        for (const QString& userName : gone) {
+            left.push_back(userName);
+        }
+        QJsonObject packet;
+        packet[Packet::Type::TYPE]       = Packet::Type::PRESENCE;
+        packet[Packet::Data::GROUP_NAME] = it.key();
+        packet[Packet::Data::JOINED]     = QJsonArray();
+        packet[Packet::Data::LEFT]       = QJsonArray::fromStringList(left);
+        emit packetReceivedSig(it.key(), packet);
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef CLUSTER_NODE_H
+#define CLUSTER_NODE_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QJsonObject>
+#include <QTimer>
+
+class QIODevice;
+
+/* link of one server process to the cluster broker,
+ * keeps the members other nodes reported so joiners see the whole group */
+class ClusterNode : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(ClusterNode)
+public:
+    ClusterNode(const QString& brokerAddress, const QString& nodeId, QObject* parent = nullptr);
+    void start();
+    void subscribe(const QString& groupName);
+    void unsubscribe(const QString& groupName);
+    void publish(const QString& groupName, const QJsonObject& packet);
+    [[nodiscard]] QStringList remoteMembers(const QString& groupName) const;
+
+private slots:
+    void connectToBroker();
+    void onConnected();
+    void onDisconnected();
+    void onReadyRead();
+signals:
+    void packetReceivedSig(const QString& groupName, const QJsonObject& packet);
+    void syncRequestedSig(const QString& groupName);
+
+private:
+    void frameReceived(const QJsonObject& frame);
+    void remotePresence(const QString& node, const QString& groupName, const QJsonObject& packet);
+    void nodeDown(const QString& node);
+    void send(const QJsonObject& frame);
+
+private:
+    const QString brokerAddress;
+    const QString nodeId;
+    QIODevice* link;
+    QTimer* retryTimer;
+    bool linked;
+    QSet<QString> groups;
+    QHash<QString, QHash<QString, QSet<QString>>> members; // group -> node -> user names
+    static constexpr int retryInterval = 1000;
+};
+
+#endif // CLUSTER_NODE_H
@@ -0,0 +1,59 @@
+#include <QDataStream>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include "clusterprotocol.h"
+#include "constants.h"
+
+QIODevice* cluster::connectTo(const QString& address, QObject* parent)
+{
+    if (address.startsWith(QLatin1String("local:"))) {
+        auto* socket = new QLocalSocket(parent);
+        socket->connectToServer(address.mid(6));
+        return socket;
+    }
+    if (address.startsWith(QLatin1String("tcp:"))) {
+        const QString hostPort = address.mid(4);
+        const int separator    = hostPort.lastIndexOf(':');
+        if (separator <= 0) {
+            return nullptr;
+        }
+        auto* socket = new QTcpSocket(parent);
+        socket->connectToHost(hostPort.left(separator), hostPort.mid(separator + 1).toUShort());
+        return socket;
+    }
+    return nullptr;
+}
+
+void cluster::writeFrame(QIODevice* const device, const QJsonObject& frame)
+{
+    QDataStream stream(device);
+    stream.setVersion(SERIALIZER_VERSION);
+    stream << QJsonDocument(frame).toJson(QJsonDocument::Compact);
+}
+
+QVector<QJsonObject> cluster::readFrames(QIODevice* const device)
+{
+    QVector<QJsonObject> frames;
+    QByteArray jsonData;
+    QDataStream stream(device);
+    stream.setVersion(SERIALIZER_VERSION);
+    while (true) {
+        stream.startTransaction();
+        stream >> jsonData;
+        if (!stream.commitTransaction()) {
+            break;
+        }
+        const QJsonDocument jsonDoc = QJsonDocument::fromJson(jsonData);
+        if (jsonDoc.isObject()) {
+            frames.push_back(jsonDoc.object());
+        }
+    }
+    return frames;
+}
+
+bool cluster::isEqualType(const QJsonObject& frame, const char* const type)
+{
+    return frame.value(QLatin1String(Type::TYPE)).toString() == QLatin1String(type);
+}
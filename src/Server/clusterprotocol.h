@@ -0,0 +1,32 @@
+#ifndef CLUSTER_PROTOCOL_H
+#define CLUSTER_PROTOCOL_H
+
+#include <QIODevice>
+#include <QJsonObject>
+#include <QVector>
+
+/* frames exchanged between server nodes and the broker, same framing as the client protocol */
+namespace cluster {
+    namespace Type {
+        constexpr const char* const TYPE        = "type";
+        constexpr const char* const HELLO       = "hello";
+        constexpr const char* const SUBSCRIBE   = "subscribe";
+        constexpr const char* const UNSUBSCRIBE = "unsubscribe";
+        constexpr const char* const PUBLISH     = "publish";
+        constexpr const char* const SYNC        = "sync";
+        constexpr const char* const NODE_DOWN   = "node_down";
+    } // namespace Type
+    namespace Data {
+        constexpr const char* const NODE   = "node";
+        constexpr const char* const GROUP  = "group";
+        constexpr const char* const PACKET = "packet";
+    } // namespace Data
+
+    /* address is "local:<name>" for a local socket or "tcp:<host>:<port>" */
+    QIODevice* connectTo(const QString& address, QObject* parent);
+    void writeFrame(QIODevice* device, const QJsonObject& frame);
+    QVector<QJsonObject> readFrames(QIODevice* device);
+    bool isEqualType(const QJsonObject& frame, const char* type);
+} // namespace cluster
+
+#endif // CLUSTER_PROTOCOL_H
@@ -2,6 +2,7 @@
 #include <QTimer>
 #include "connectionpool.h"
 #include "config.h"
+#include "metrics.h"
 
 ConnectionPool::ConnectionPool()
 {
@@ -16,6 +17,7 @@ ConnectionPool::~ConnectionPool()
 {
     timer->stop();
     for (const auto& connectionName : usedConnections) {
+        dropStatements(connectionName);
         QSqlDatabase::removeDatabase(connectionName);
     }
     delete timer;
@@ -39,6 +41,17 @@ void ConnectionPool::release()
     instance = nullptr;
 }
 
+void ConnectionPool::configure(const QString& driver, const QString& database, const bool statementCache)
+{
+    {
+        QMutexLocker locker(&mutex);
+        driverName   = driver;
+        databaseName = database;
+    }
+    QMutexLocker locker(&statementsMutex);
+    cacheStatements = statementCache;
+}
+
 QSqlDatabase ConnectionPool::getConnection()
 {
     ConnectionPool& pool = ConnectionPool::getInstance();
@@ -74,6 +87,7 @@ void ConnectionPool::releaseConnection(const QSqlDatabase& connection)
     ConnectionPool& pool   = ConnectionPool::getInstance();
     QString connectionName = connection.connectionName();
     if (pool.usedConnections.contains(connectionName)) {
+        finishStatements(connectionName);
         QMutexLocker locker(&mutex);
         pool.usedConnections.removeOne(connectionName);
         pool.unusedConnections.enqueue({connectionName, false});
@@ -88,18 +102,22 @@ QSqlDatabase ConnectionPool::createConnection(const QString& connectionName)
 
         if (testOnBorrow) {
             QSqlQuery query(testOnBorrowQuery, db);
-            if (query.lastError().type() != QSqlError::NoError && !db.open()) {
-                qWarning() << qPrintable(QString("DB fail:") + db.lastError().text());
-                return {};
+            if (query.lastError().type() != QSqlError::NoError) {
+                // statements prepared on the lost session are gone with it
+                dropStatements(connectionName);
+                if (!db.open()) {
+                    qWarning() << qPrintable(QString("DB fail:") + db.lastError().text());
+                    return {};
+                }
             }
         }
 
         return db;
     }
 
-    QSqlDatabase db = QSqlDatabase::addDatabase(DB_TYPE, connectionName);
+    QSqlDatabase db = QSqlDatabase::addDatabase(driverName.isEmpty() ? QString(DB_TYPE) : driverName, connectionName);
     db.setHostName(DB_HOSTNAME);
-    db.setDatabaseName(DB_NAME);
+    db.setDatabaseName(databaseName.isEmpty() ? QString(DB_NAME) : databaseName);
     db.setUserName(DB_USERNAME);
     db.setPassword(DB_PASSWORD);
 
@@ -117,9 +135,59 @@ void ConnectionPool::releaseUnusedConnections()
     QMutexLocker locker(&mutex);
     for (auto& unusedConnection : unusedConnections) {
         if (!unusedConnection.released) {
+            dropStatements(unusedConnection.connectionName);
             QSqlDatabase::removeDatabase(unusedConnection.connectionName);
             qInfo() << "released connection: " << unusedConnection.connectionName;
             unusedConnection.released = true;
         }
     }
 }
+
+QSqlQuery ConnectionPool::prepare(const QSqlDatabase& connection, const QString& sql)
+{
+    const QString connectionName = connection.connectionName();
+    {
+        QMutexLocker locker(&statementsMutex);
+        const auto connectionStatements = statements.constFind(connectionName);
+        if (connectionStatements != statements.constEnd()) {
+            const auto cached = connectionStatements->constFind(sql);
+            if (cached != connectionStatements->constEnd()) {
+                Metrics::increment("db.statement_reuses");
+                return *cached;
+            }
+        }
+    }
+
+    QSqlQuery query(connection);
+    if (!query.prepare(sql)) {
+        qWarning() << qPrintable(QString("DB prepare fail:") + query.lastError().text());
+        return query;
+    }
+    Metrics::increment("db.statements_prepared");
+    QMutexLocker locker(&statementsMutex);
+    if (cacheStatements) {
+        statements[connectionName].insert(sql, query);
+    }
+    return query;
+}
+
+/* a cached statement keeps the result of its last run until it runs again, the borrower is done with it */
+void ConnectionPool::finishStatements(const QString& connectionName)
+{
+    QMutexLocker locker(&statementsMutex);
+    const auto connectionStatements = statements.find(connectionName);
+    if (connectionStatements == statements.end()) {
+        return;
+    }
+    for (QSqlQuery& statement : *connectionStatements) {
+        if (statement.isActive()) {
+            statement.finish();
+        }
+    }
+}
+
+void ConnectionPool::dropStatements(const QString& connectionName)
+{
+    QMutexLocker locker(&statementsMutex);
+    statements.remove(connectionName);
+}
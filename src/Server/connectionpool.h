@@ -15,12 +15,20 @@ public:
     static QSqlDatabase getConnection();
     static void releaseConnection(const QSqlDatabase& connection);
     static void release();
+    /* driver and database used for new connections, config.h values stay the default.
+     * without the statement cache every prepare() parses its query again */
+    static void configure(const QString& driver, const QString& databaseName, bool statementCache = true);
+    /* the statement prepared once per connection, copies share it so only the borrower may use it,
+     * results are freed when the connection is released and the statement stays prepared */
+    static QSqlQuery prepare(const QSqlDatabase& connection, const QString& sql);
     ~ConnectionPool() override;
 
 private:
     ConnectionPool();
     static ConnectionPool& getInstance();
     static QSqlDatabase createConnection(const QString& connectionName);
+    static void finishStatements(const QString& connectionName);
+    static void dropStatements(const QString& connectionName);
 
 private slots:
     void releaseUnusedConnections();
@@ -43,6 +51,11 @@ private:
     static inline QMutex mutex{};
     static inline QWaitCondition waitConnection{};
     static inline ConnectionPool* instance = nullptr;
+    static inline QString driverName{};
+    static inline QString databaseName{};
+    static inline QMutex statementsMutex{};
+    static inline bool cacheStatements = true;
+    static inline QHash<QString, QHash<QString, QSqlQuery>> statements{}; // connection -> sql -> statement
 };
 
 #endif // CONNECTIONPOOL_H
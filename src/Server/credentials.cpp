@@ -0,0 +1,100 @@
+#include <QCryptographicHash>
+#include <QMessageAuthenticationCode>
+#include <QStringList>
+#include <random>
+#include "credentials.h"
+
+namespace {
+    constexpr const char* const scheme = "pbkdf2_sha256";
+    constexpr int saltSize             = 16;
+    constexpr int keySize              = 32;
+
+    /* PBKDF2-HMAC-SHA256 (RFC 8018) */
+    QByteArray pbkdf2(const QByteArray& password, const QByteArray& salt, const int iterations, const int keyLength)
+    {
+        QMessageAuthenticationCode mac(QCryptographicHash::Sha256, password);
+        QByteArray key;
+        for (quint32 block = 1; key.size() < keyLength; ++block) {
+            QByteArray blockIndex(4, '\0');
+            blockIndex[0] = static_cast<char>((block >> 24) & 0xff);
+            blockIndex[1] = static_cast<char>((block >> 16) & 0xff);
+            blockIndex[2] = static_cast<char>((block >> 8) & 0xff);
+            blockIndex[3] = static_cast<char>(block & 0xff);
+
+            mac.reset();
+            mac.addData(salt);
+            mac.addData(blockIndex);
+            QByteArray u = mac.result();
+            QByteArray t = u;
+            for (int i = 1; i < iterations; ++i) {
+                mac.reset();
+                mac.addData(u);
+                u = mac.result();
+                for (int j = 0; j < t.size(); ++j) {
+                    t[j] = static_cast<char>(t[j] ^ u[j]);
+                }
+            }
+            key.append(t);
+        }
+        return key.left(keyLength);
+    }
+
+    QByteArray randomSalt()
+    {
+        thread_local std::mt19937 engine{std::random_device{}()};
+        std::uniform_int_distribution<int> distribution(0, 255);
+        QByteArray salt(saltSize, '\0');
+        for (auto& byte : salt) {
+            byte = static_cast<char>(distribution(engine));
+        }
+        return salt;
+    }
+
+    bool constantTimeEquals(const QByteArray& lhs, const QByteArray& rhs)
+    {
+        if (lhs.size() != rhs.size()) {
+            return false;
+        }
+        char diff = 0;
+        for (int i = 0; i < lhs.size(); ++i) {
+            diff = static_cast<char>(diff | (lhs[i] ^ rhs[i]));
+        }
+        return diff == 0;
+    }
+} // namespace
+
+/* stored format: pbkdf2_sha256$<iterations>$<base64 salt>$<base64 key> */
+QString credentials::hash(const QString& password, const int iterations)
+{
+    const QByteArray salt = randomSalt();
+    const QByteArray key  = pbkdf2(password.toUtf8(), salt, iterations, keySize);
+    return QString("%1$%2$%3$%4")
+            .arg(QLatin1String(scheme))
+            .arg(iterations)
+            .arg(QString::fromLatin1(salt.toBase64()))
+            .arg(QString::fromLatin1(key.toBase64()));
+}
+
+bool credentials::verify(const QString& password, const QString& stored)
+{
+    if (!isHashed(stored)) {
+        return password == stored;
+    }
+    const QStringList parts = stored.split('$');
+    if (parts.size() != 4) {
+        return false;
+    }
+    bool ok              = false;
+    const int iterations = parts[1].toInt(&ok);
+    if (!ok || iterations <= 0) {
+        return false;
+    }
+    const QByteArray salt     = QByteArray::fromBase64(parts[2].toLatin1());
+    const QByteArray expected = QByteArray::fromBase64(parts[3].toLatin1());
+    return constantTimeEquals(pbkdf2(password.toUtf8(), salt, iterations, expected.size()), expected);
+}
+
+bool credentials::isHashed(const QString& stored)
+{
+    return stored.startsWith(QLatin1String(scheme) + QLatin1Char('$'));
+}
@@ -0,0 +1,12 @@
+#ifndef CREDENTIALS_H
+#define CREDENTIALS_H
+
+#include <QString>
+
+namespace credentials {
+    QString hash(const QString& password, int iterations);
+    bool verify(const QString& password, const QString& stored);
+    bool isHashed(const QString& stored);
+} // namespace credentials
+
+#endif // CREDENTIALS_H
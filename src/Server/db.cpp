@@ -1,134 +1,129 @@
 #include <QString>
-#include <QSqlDatabase>
-#include <QSqlQuery>
-#include "servercore.h"
-#include "connectionpool.h"
+#include <memory>
+#include <algorithm>
 #include "db.h"
+#include "storage.h"
+#include "sqlstorage.h"
+#include "memorystorage.h"
+#include "connectionpool.h"
+#include "messagelog.h"
+
+namespace {
+    std::unique_ptr<Storage> storage;
+    MessageLog* messageLog = nullptr;
+
+    Storage& backend()
+    {
+        // Postgres stays the default when nothing was selected
+        if (!storage) {
+            storage = std::make_unique<SqlStorage>(SqlStorage::Dialect::Postgres);
+        }
+        return *storage;
+    }
+} // namespace
 
-bool db::isUserExist(const QString& userName)
+bool db::init(const QString& backendName, const QString& databaseName, const bool statementCache)
 {
-    auto conn = ConnectionPool::getConnection();
-    QSqlQuery query(conn);
-    query.prepare(R"(select id from "Messenger".public.user where "name" = :name)");
-    query.bindValue(":name", userName);
-    query.exec();
-
-    int id = 0;
-    while (query.next()) {
-        id = query.value("id").toInt();
+    if (backendName == QLatin1String("memory")) {
+        storage = std::make_unique<MemoryStorage>();
+    } else if (backendName == QLatin1String("sqlite")) {
+        ConnectionPool::configure("QSQLITE", databaseName, statementCache);
+        storage = std::make_unique<SqlStorage>(SqlStorage::Dialect::Sqlite);
+    } else if (backendName == QLatin1String("postgres")) {
+        ConnectionPool::configure("QPSQL", databaseName, statementCache);
+        storage = std::make_unique<SqlStorage>(SqlStorage::Dialect::Postgres);
+    } else {
+        return false;
     }
-    ConnectionPool::releaseConnection(conn);
+    return true;
+}
+
+void db::setMessageLog(MessageLog* const log)
+{
+    messageLog = log;
+}
 
-    return id != 0;
+bool db::isUserExist(const QString& userName)
+{
+    return backend().isUserExist(userName);
 }
 
-void db::addUser(const QString& userName, const QString& password)
+bool db::addUser(const QString& userName, const QString& password)
 {
-    auto conn = ConnectionPool::getConnection();
-    QSqlQuery query(conn);
-    query.prepare(R"(insert into "Messenger".public.user (name, password)
-values (:name, :password))");
-    query.bindValue(":name", userName);
-    query.bindValue(":password", password);
-    query.exec();
-    ConnectionPool::releaseConnection(conn);
+    return backend().addUser(userName, password);
+}
+
+void db::updateUserPassword(const QString& userName, const QString& password)
+{
+    backend().updateUserPassword(userName, password);
 }
 
 void db::addGroup(const QString& groupName, const QString& password)
 {
-    auto conn = ConnectionPool::getConnection();
-    QSqlQuery query(conn);
-    query.prepare(R"(insert into "Messenger".public.group (name, password)
-values (:name, :password))");
-    query.bindValue(":name", groupName);
-    query.bindValue(":password", password);
-    query.exec();
-    ConnectionPool::releaseConnection(conn);
+    backend().addGroup(groupName, password);
 }
 
 QString db::fetchUserPassword(const QString& userName)
 {
-    auto conn = ConnectionPool::getConnection();
-    QSqlQuery query(conn);
-    query.prepare(R"(select password from "Messenger".public.user where "name" = :name)");
-    query.bindValue(":name", userName);
-    query.exec();
-
-    QString password;
-    while (query.next()) {
-        password = query.value("password").toString();
-    }
-    ConnectionPool::releaseConnection(conn);
-
-    return password;
+    return backend().fetchUserPassword(userName);
 }
 
 bool db::isGroupExist(const QString& groupName)
 {
-    auto conn = ConnectionPool::getConnection();
-    QSqlQuery query(conn);
-    query.prepare(R"(select id from "Messenger".public.group where "name" = :name)");
-    query.bindValue(":name", groupName);
-    query.exec();
-
-    int id = 0;
-    while (query.next()) {
-        id = query.value("id").toInt();
-    }
-    ConnectionPool::releaseConnection(conn);
-
-    return id != 0;
+    return backend().isGroupExist(groupName);
 }
 
 QString db::fetchGroupPassword(const QString& groupName)
 {
-    auto conn = ConnectionPool::getConnection();
-    QSqlQuery query(conn);
-    query.prepare(R"(select * from "Messenger".public.group where "name" = :name)");
-    query.bindValue(":name", groupName);
-    query.exec();
-
-    QString password;
-    while (query.next()) {
-        password = query.value("password").toString();
+    return backend().fetchGroupPassword(groupName);
+}
+
+db::GroupJoin db::fetchGroupJoin(const QString& groupName, const qint64 afterId)
+{
+    if (messageLog) {
+        // only the group row is remote, messages come from the local log
+        GroupJoin join;
+        join.password = backend().fetchGroupPassword(groupName);
+        join.exists   = !join.password.isEmpty();
+        if (join.exists) {
+            join.messages = messageLog->fetch(groupName, afterId);
+        }
+        return join;
     }
-    ConnectionPool::releaseConnection(conn);
+    return backend().fetchGroupJoin(groupName, afterId);
+}
 
-    return password;
+qint64 db::addMessage(const Message& message)
+{
+    if (messageLog) {
+        return messageLog->append(message);
+    }
+    return backend().addMessage(message);
 }
 
-void db::addMessage(const Message& message)
+QList<Message> db::fetchMessages(const QString& groupName, const qint64 afterId)
 {
-    auto conn = ConnectionPool::getConnection();
-    QSqlQuery query(conn);
-    query.prepare(R"(insert into message (group_name, sender_name, message, time)
-values (:group_name, :sender_name, :message, :time))");
-    query.bindValue(":group_name", message.getGroupName());
-    query.bindValue(":sender_name", message.getSender());
-    query.bindValue(":message", message.getMessage());
-    query.bindValue(":time", message.getTime());
-    query.exec();
-    ConnectionPool::releaseConnection(conn);
+    if (messageLog) {
+        return messageLog->fetch(groupName, afterId);
+    }
+    return backend().fetchMessages(groupName, afterId);
 }
 
-QList<Message> db::fetchMessages(const QString& groupName)
+QList<Message> db::fetchMessagesByIds(const QString& groupName, const QVector<qint64>& ids)
 {
-    auto conn = ConnectionPool::getConnection();
-    QSqlQuery query(conn);
-    query.prepare(R"(select m.sender_name, m.message, m.time
-from message m
-where m.group_name = :name)");
-    query.bindValue(":name", groupName);
-    query.exec();
-
-    QList<Message> messages;
-    while (query.next()) {
-        QString senderName = query.value("sender_name").toString();
-        QString text       = query.value("message").toString();
-        QString time       = query.value("time").toString();
-        messages.push_back({groupName, qMove(senderName), qMove(text), qMove(time)});
+    QVector<qint64> sortedIds = ids;
+    std::sort(sortedIds.begin(), sortedIds.end());
+    if (messageLog) {
+        return messageLog->fetchIds(groupName, sortedIds);
     }
-    ConnectionPool::releaseConnection(conn);
+    return backend().fetchMessagesByIds(groupName, sortedIds);
+}
 
-    return messages;
+QList<Message> db::fetchMessagesInRange(const QString& groupName, const qint64 from, const qint64 to,
+                                        const qint64 afterId, const int limit)
+{
+    if (messageLog) {
+        return messageLog->fetchRange(groupName, from, to, afterId, limit);
+    }
+    return backend().fetchMessagesInRange(groupName, from, to, afterId, limit);
 }
@@ -2,17 +2,38 @@
 #define DB_H
 
 #include <QString>
+#include <QVector>
 #include "message.h"
 
+class MessageLog;
+
 namespace db {
+    /* selects the backend: postgres, sqlite or memory, Postgres is used when never called */
+    bool init(const QString& backendName, const QString& databaseName = QString(), bool statementCache = true);
+    /* messages go to the embedded log instead of the database while one is set */
+    void setMessageLog(MessageLog* log);
     bool isUserExist(const QString& userName);
     bool isGroupExist(const QString& groupName);
-    void addUser(const QString& userName, const QString& password);
+    /* false when the name is already taken */
+    bool addUser(const QString& userName, const QString& password);
+    void updateUserPassword(const QString& userName, const QString& password);
     void addGroup(const QString& groupName, const QString& password);
     QString fetchUserPassword(const QString& userName);
     QString fetchGroupPassword(const QString& groupName);
-    void addMessage(const Message& message);
-    QList<Message> fetchMessages(const QString& groupName);
+    /* the group row and the messages after afterId, read in a single round trip */
+    struct GroupJoin
+    {
+        bool exists = false;
+        QString password;
+        QList<Message> messages;
+    };
+    GroupJoin fetchGroupJoin(const QString& groupName, qint64 afterId);
+    qint64 addMessage(const Message& message);
+    QList<Message> fetchMessages(const QString& groupName, qint64 afterId = 0);
+    /* messages with the given ids in id order, missing ones are skipped */
+    QList<Message> fetchMessagesByIds(const QString& groupName, const QVector<qint64>& ids);
+    /* up to limit messages stamped in [from, to) ordered by time, a page goes on after (from, afterId) */
+    QList<Message> fetchMessagesInRange(const QString& groupName, qint64 from, qint64 to, qint64 afterId, int limit);
 } // namespace db
 
 #endif // DB_H
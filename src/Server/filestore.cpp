@@ -0,0 +1,65 @@
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include "filestore.h"
+
+FileStore::FileStore(const QString& directory, const qint64 maxFileSize)
+    : directory(directory), maxFileSize(maxFileSize)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    QDir incoming(directory + QString("/incoming"));
+    if (!incoming.mkpath(".")) {
+        qWarning() << qPrintable(QString("unable to create file store in %1").arg(directory));
+        return;
+    }
+    // left by a crash, a process taking over on drain still writes its own recent ones
+    const QDateTime stale = QDateTime::currentDateTime().addSecs(-staleUploadAge);
+    for (const QFileInfo& part : incoming.entryInfoList({"*.part"}, QDir::Files)) {
+        if (part.lastModified() < stale) {
+            QFile::remove(part.filePath());
+        }
+    }
+}
+
+bool FileStore::isEnabled() const
+{
+    return !directory.isEmpty() && maxFileSize > 0;
+}
+
+qint64 FileStore::getMaxFileSize() const
+{
+    return maxFileSize;
+}
+
+bool FileStore::contains(const QString& hash) const
+{
+    return QFileInfo(filePath(hash)).isFile();
+}
+
+QString FileStore::filePath(const QString& hash) const
+{
+    // fan out over 256 directories to keep them short
+    return QString("%1/%2/%3").arg(directory, hash.left(2), hash);
+}
+
+QString FileStore::partPath(const QString& hash, const quintptr uploader) const
+{
+    return QString("%1/incoming/%2-%3.part").arg(directory, hash).arg(uploader, 0, 16);
+}
+
+bool FileStore::isValidHash(const QString& hash)
+{
+    if (hash.size() != 64) {
+        return false;
+    }
+    for (const QChar c : hash) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,26 @@
+#ifndef FILE_STORE_H
+#define FILE_STORE_H
+
+#include <QString>
+
+/* attachments on disk addressed by their sha-256, a file sent to many groups is stored once,
+ * uploads grow under incoming/ until the worker that receives them checks the hash */
+class FileStore
+{
+public:
+    FileStore(const QString& directory, qint64 maxFileSize);
+    [[nodiscard]] bool isEnabled() const;
+    [[nodiscard]] qint64 getMaxFileSize() const;
+    [[nodiscard]] bool contains(const QString& hash) const;
+    [[nodiscard]] QString filePath(const QString& hash) const;
+    /* where an upload of one connection grows, unique per connection so parallel uploads never share it */
+    [[nodiscard]] QString partPath(const QString& hash, quintptr uploader) const;
+    static bool isValidHash(const QString& hash);
+
+private:
+    const QString directory;
+    const qint64 maxFileSize;
+    static constexpr int staleUploadAge = 60 * 60; // s
+};
+
+#endif // FILE_STORE_H
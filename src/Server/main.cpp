@@ -1,6 +1,7 @@
 #include <QApplication>
 #include <exception>
 #include "servercontroller.h"
+#include "serverconfig.h"
 #include "utils.h"
 
 int main(int argc, char* argv[])
@@ -9,7 +10,7 @@ int main(int argc, char* argv[])
     qInstallMessageHandler(messageHandler);
 
     qInfo() << "--- start server ---";
-    ServerController server;
+    ServerController server(ServerConfig::fromArguments(QApplication::arguments()));
     server.startServer();
 
     return QApplication::exec();
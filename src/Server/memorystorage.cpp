@@ -0,0 +1,127 @@
+#include <QMutexLocker>
+#include <algorithm>
+#include "memorystorage.h"
+
+bool MemoryStorage::isUserExist(const QString& userName)
+{
+    QMutexLocker locker(&mutex);
+    return users.contains(userName);
+}
+
+bool MemoryStorage::isGroupExist(const QString& groupName)
+{
+    QMutexLocker locker(&mutex);
+    return groups.contains(groupName);
+}
+
+bool MemoryStorage::addUser(const QString& userName, const QString& password)
+{
+    QMutexLocker locker(&mutex);
+    if (users.contains(userName)) {
+        return false;
+    }
+    users.insert(userName, password);
+    return true;
+}
+
+void MemoryStorage::updateUserPassword(const QString& userName, const QString& password)
+{
+    QMutexLocker locker(&mutex);
+    if (users.contains(userName)) {
+        users.insert(userName, password);
+    }
+}
+
+void MemoryStorage::addGroup(const QString& groupName, const QString& password)
+{
+    QMutexLocker locker(&mutex);
+    if (!groups.contains(groupName)) {
+        groups.insert(groupName, password);
+    }
+}
+
+QString MemoryStorage::fetchUserPassword(const QString& userName)
+{
+    QMutexLocker locker(&mutex);
+    return users.value(userName);
+}
+
+QString MemoryStorage::fetchGroupPassword(const QString& groupName)
+{
+    QMutexLocker locker(&mutex);
+    return groups.value(groupName);
+}
+
+db::GroupJoin MemoryStorage::fetchGroupJoin(const QString& groupName, const qint64 afterId)
+{
+    db::GroupJoin join;
+    {
+        QMutexLocker locker(&mutex);
+        const auto group = groups.constFind(groupName);
+        if (group == groups.constEnd()) {
+            return join;
+        }
+        join.exists   = true;
+        join.password = *group;
+    }
+    join.messages = fetchMessages(groupName, afterId);
+    return join;
+}
+
+qint64 MemoryStorage::addMessage(const Message& message)
+{
+    QMutexLocker locker(&mutex);
+    const qint64 id = ++lastMessageId;
+    Message stored = message;
+    stored.setId(id);
+    messages[message.getGroupName()].push_back(stored);
+    return id;
+}
+
+QList<Message> MemoryStorage::fetchMessages(const QString& groupName, const qint64 afterId)
+{
+    QMutexLocker locker(&mutex);
+    const QVector<Message> groupMessages = messages.value(groupName);
+    // ids grow with every append, the list is sorted by them
+    const auto first = std::upper_bound(groupMessages.cbegin(), groupMessages.cend(), afterId,
+                                        [](const qint64 id, const Message& message) { return id < message.getId(); });
+    QList<Message> result;
+    for (auto it = first; it != groupMessages.cend(); ++it) {
+        result.push_back(*it);
+    }
+    return result;
+}
+
+QList<Message> MemoryStorage::fetchMessagesByIds(const QString& groupName, const QVector<qint64>& ids)
+{
+    QMutexLocker locker(&mutex);
+    const QVector<Message> groupMessages = messages.value(groupName);
+    QList<Message> result;
+    for (const qint64 id : ids) {
+        const auto found = std::lower_bound(
+            groupMessages.cbegin(), groupMessages.cend(), id,
+            [](const Message& message, const qint64 wanted) { return message.getId() < wanted; });
+        if (found != groupMessages.cend() && found->getId() == id) {
+            result.push_back(*found);
+        }
+    }
+    return result;
+}
+
+QList<Message> MemoryStorage::fetchMessagesInRange(const QString& groupName, const qint64 from, const qint64 to,
+                                                   const qint64 afterId, const int limit)
+{
+    QMutexLocker locker(&mutex);
+    const QVector<Message> groupMessages = messages.value(groupName);
+    // the server stamps messages in order, timestamps grow with the ids
+    const auto first = std::lower_bound(
+        groupMessages.cbegin(), groupMessages.cend(), from,
+        [](const Message& message, const qint64 stamp) { return message.getTimestamp() < stamp; });
+    QList<Message> result;
+    for (auto it = first; it != groupMessages.cend() && it->getTimestamp() < to && result.size() < limit; ++it) {
+        if (it->getTimestamp() > from || it->getId() > afterId) {
+            result.push_back(*it);
+        }
+    }
+    return result;
+}
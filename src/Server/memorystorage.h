@@ -0,0 +1,35 @@
+#ifndef MEMORY_STORAGE_H
+#define MEMORY_STORAGE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include "storage.h"
+
+/* keeps everything in process memory, for benchmarks and tests without a database */
+class MemoryStorage : public Storage
+{
+public:
+    bool isUserExist(const QString& userName) override;
+    bool isGroupExist(const QString& groupName) override;
+    bool addUser(const QString& userName, const QString& password) override;
+    void updateUserPassword(const QString& userName, const QString& password) override;
+    void addGroup(const QString& groupName, const QString& password) override;
+    QString fetchUserPassword(const QString& userName) override;
+    QString fetchGroupPassword(const QString& groupName) override;
+    db::GroupJoin fetchGroupJoin(const QString& groupName, qint64 afterId) override;
+    qint64 addMessage(const Message& message) override;
+    QList<Message> fetchMessages(const QString& groupName, qint64 afterId) override;
+    QList<Message> fetchMessagesByIds(const QString& groupName, const QVector<qint64>& ids) override;
+    QList<Message> fetchMessagesInRange(const QString& groupName, qint64 from, qint64 to, qint64 afterId,
+                                        int limit) override;
+
+private:
+    QMutex mutex;
+    QHash<QString, QString> users;  // name -> password
+    QHash<QString, QString> groups; // name -> password
+    QHash<QString, QVector<Message>> messages;
+    qint64 lastMessageId = 0;
+};
+
+#endif // MEMORY_STORAGE_H
@@ -0,0 +1,697 @@
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QtEndian>
+#include <algorithm>
+#include <array>
+#include <functional>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+#include "messagelog.h"
+#include "constants.h"
+#include "metrics.h"
+
+namespace {
+    constexpr int recordHeaderSize  = 8; // payload size and crc32
+    constexpr int indexEntrySize    = 16;
+    constexpr quint32 maxRecordSize = 1024 * 1024;
+
+    class CompactionTask : public QRunnable
+    {
+    public:
+        explicit CompactionTask(std::function<void()> task) : task(std::move(task)) {}
+        void run() override
+        {
+            task();
+        }
+
+    private:
+        std::function<void()> task;
+    };
+
+    quint32 crc32(const QByteArray& data)
+    {
+        static const auto table = [] {
+            std::array<quint32, 256> result{};
+            for (quint32 i = 0; i < 256; ++i) {
+                quint32 value = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+                }
+                result[i] = value;
+            }
+            return result;
+        }();
+        quint32 crc = 0xffffffffu;
+        for (const char byte : data) {
+            crc = table[(crc ^ static_cast<quint8>(byte)) & 0xff] ^ (crc >> 8);
+        }
+        return crc ^ 0xffffffffu;
+    }
+
+    QString segmentName(const qint64 firstId)
+    {
+        // zero padded so that sorting by name sorts by id
+        return QString("%1").arg(firstId, 20, 10, QLatin1Char('0'));
+    }
+
+    QByteArray encodePayload(const qint64 id, const Message& message)
+    {
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setVersion(SERIALIZER_VERSION);
+        stream << id << message.getSender() << message.getMessage().toString() << message.getTime()
+               << message.getTimestamp() << message.getAttachment().toString() << message.getAttachmentSize();
+        return payload;
+    }
+
+    QByteArray encodeRecord(const QByteArray& payload)
+    {
+        QByteArray record(recordHeaderSize, Qt::Uninitialized);
+        qToBigEndian<quint32>(static_cast<quint32>(payload.size()), reinterpret_cast<uchar*>(record.data()));
+        qToBigEndian<quint32>(crc32(payload), reinterpret_cast<uchar*>(record.data() + 4));
+        return record + payload;
+    }
+
+    qint64 recordId(const QByteArray& payload)
+    {
+        // the id leads the payload
+        if (payload.size() < static_cast<int>(sizeof(qint64))) {
+            return 0;
+        }
+        return qFromBigEndian<qint64>(reinterpret_cast<const uchar*>(payload.constData()));
+    }
+
+    Message decodeRecord(const QString& groupName, const QByteArray& payload)
+    {
+        QDataStream stream(payload);
+        stream.setVersion(SERIALIZER_VERSION);
+        qint64 id = 0;
+        QString sender;
+        QString text;
+        QString time;
+        stream >> id >> sender >> text >> time;
+        // records written before messages were stamped end after the time
+        qint64 timestamp = 0;
+        if (!stream.atEnd()) {
+            stream >> timestamp;
+        }
+        Message message(groupName, sender, text, time, id, timestamp);
+        if (!stream.atEnd()) {
+            QString attachment;
+            qint64 attachmentSize = 0;
+            stream >> attachment >> attachmentSize;
+            message.setAttachment(attachment, attachmentSize);
+        }
+        return message;
+    }
+
+    /* reads the record at the current position, false at the end of the valid data */
+    bool readRecord(QFile& file, QByteArray& payload)
+    {
+        const QByteArray header = file.read(recordHeaderSize);
+        if (header.size() < recordHeaderSize) {
+            return false;
+        }
+        const auto* raw    = reinterpret_cast<const uchar*>(header.constData());
+        const quint32 size = qFromBigEndian<quint32>(raw);
+        const quint32 crc  = qFromBigEndian<quint32>(raw + 4);
+        if (size > maxRecordSize) {
+            return false;
+        }
+        payload = file.read(size);
+        return payload.size() == static_cast<int>(size) && crc32(payload) == crc;
+    }
+
+    /* visits the valid records from offset on, returns where the valid data ends */
+    qint64 scanSegment(QFile& file, qint64 offset, const std::function<void(qint64, const QByteArray&)>& visit)
+    {
+        file.seek(offset);
+        QByteArray payload;
+        while (readRecord(file, payload)) {
+            visit(offset, payload);
+            offset += recordHeaderSize + payload.size();
+        }
+        return offset;
+    }
+
+    void writeIndexEntry(QFile& index, const qint64 id, const qint64 offset)
+    {
+        uchar entry[indexEntrySize];
+        qToLittleEndian<qint64>(id, entry);
+        qToLittleEndian<qint64>(offset, entry + sizeof(qint64));
+        index.write(reinterpret_cast<const char*>(entry), indexEntrySize);
+    }
+
+    void syncFile(QFile& file)
+    {
+        file.flush();
+#ifdef Q_OS_UNIX
+        ::fsync(file.handle());
+#endif
+    }
+
+    /* rewrites the index of a segment, returns where its valid data ends */
+    qint64 buildIndex(const QString& path, const qint64 indexInterval,
+                      const std::function<void(const QByteArray&)>& visit = {})
+    {
+        QFile log(path + ".log");
+        QFile index(path + ".idx");
+        if (!log.open(QIODevice::ReadOnly) || !index.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            return 0;
+        }
+        qint64 lastIndexed = -indexInterval;
+        return scanSegment(log, 0, [&](const qint64 offset, const QByteArray& payload) {
+            if (offset - lastIndexed >= indexInterval) {
+                writeIndexEntry(index, recordId(payload), offset);
+                lastIndexed = offset;
+            }
+            if (visit) {
+                visit(payload);
+            }
+        });
+    }
+
+    qint64 lastRecordId(const QString& path)
+    {
+        QFile log(path + ".log");
+        if (!log.open(QIODevice::ReadOnly)) {
+            return 0;
+        }
+        // start from the last indexed record if there is an index
+        qint64 offset = 0;
+        QFile index(path + ".idx");
+        if (index.open(QIODevice::ReadOnly) && index.size() >= indexEntrySize) {
+            index.seek((index.size() / indexEntrySize - 1) * indexEntrySize);
+            const QByteArray entry = index.read(indexEntrySize);
+            offset = qFromLittleEndian<qint64>(reinterpret_cast<const uchar*>(entry.constData()) + sizeof(qint64));
+        }
+        qint64 id = 0;
+        scanSegment(log, offset, [&id](qint64, const QByteArray& payload) { id = recordId(payload); });
+        return id;
+    }
+
+    /* runs on the compaction pool, only touches sealed segments */
+    bool mergeSegments(const QStringList& sources, const QString& target, const qint64 indexInterval)
+    {
+        QFile merged(target + ".compact.log");
+        QFile index(target + ".compact.idx");
+        if (!merged.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+            !index.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            return false;
+        }
+        qint64 lastIndexed = -indexInterval;
+        bool written       = true;
+        for (const QString& source : sources) {
+            QFile log(source + ".log");
+            if (!log.open(QIODevice::ReadOnly)) {
+                return false;
+            }
+            scanSegment(log, 0, [&](qint64, const QByteArray& payload) {
+                const qint64 offset = merged.pos();
+                if (offset - lastIndexed >= indexInterval) {
+                    writeIndexEntry(index, recordId(payload), offset);
+                    lastIndexed = offset;
+                }
+                const QByteArray record = encodeRecord(payload);
+                written                 = written && merged.write(record) == record.size();
+            });
+        }
+        syncFile(merged);
+        index.flush();
+        merged.close();
+        index.close();
+        // the rename is the commit point, recovery finishes a merge that got this far
+        return written && QFile::rename(target + ".compact.log", target + ".merged.log");
+    }
+} // namespace
+
+MessageLog::MessageLog(const QString& directory, const FsyncPolicy fsyncPolicy, QObject* parent)
+    : QObject(parent), directory(directory), fsyncPolicy(fsyncPolicy), syncTimer(new QTimer(this)),
+      compactionTimer(new QTimer(this))
+{
+    QDir().mkpath(directory);
+    compactionPool.setMaxThreadCount(1);
+
+    connect(syncTimer, &QTimer::timeout, this, &MessageLog::sync);
+    if (fsyncPolicy == FsyncPolicy::Interval) {
+        syncTimer->start(syncInterval);
+    }
+    connect(compactionTimer, &QTimer::timeout, this, &MessageLog::compact);
+    compactionTimer->start(compactionInterval);
+}
+
+MessageLog::~MessageLog()
+{
+    compactionPool.waitForDone();
+    for (auto& group : groups) {
+        seal(group.second);
+    }
+}
+
+MessageLog::FsyncPolicy MessageLog::fsyncPolicyFromString(const QString& name)
+{
+    if (name == QLatin1String("always")) {
+        return FsyncPolicy::Always;
+    }
+    if (name == QLatin1String("never")) {
+        return FsyncPolicy::Never;
+    }
+    return FsyncPolicy::Interval;
+}
+
+MessageLog::GroupLog& MessageLog::open(const QString& groupName)
+{
+    const auto found = groups.find(groupName);
+    if (found != groups.end()) {
+        return found->second;
+    }
+    GroupLog& log = groups[groupName];
+    log.directory = directory + QString("/") + QString::fromLatin1(groupName.toUtf8().toHex());
+    QDir().mkpath(log.directory);
+    recover(log, groupName);
+    return log;
+}
+
+void MessageLog::recover(GroupLog& log, const QString& groupName)
+{
+    QDir dir(log.directory);
+
+    // finish merges that were committed before a crash
+    for (const QString& name : dir.entryList({"*.merged.log"}, QDir::Files)) {
+        const QString base    = name.section('.', 0, 0);
+        const qint64 firstId  = base.toLongLong();
+        const qint64 mergedTo = lastRecordId(dir.filePath(base + ".merged"));
+        for (const QString& segment : dir.entryList({"*.log"}, QDir::Files)) {
+            const qint64 id = segment.section('.', 0, 0).toLongLong();
+            if (segment.count('.') == 1 && id >= firstId && id <= mergedTo) {
+                QFile::remove(dir.filePath(segment));
+                QFile::remove(dir.filePath(segment.section('.', 0, 0) + ".idx"));
+            }
+        }
+        QFile::rename(dir.filePath(name), dir.filePath(base + ".log"));
+    }
+    for (const QString& name : dir.entryList({"*.compact.*"}, QDir::Files)) {
+        QFile::remove(dir.filePath(name));
+    }
+
+    for (const QString& name : dir.entryList({"*.log"}, QDir::Files, QDir::Name)) {
+        Segment segment;
+        segment.firstId = name.section('.', 0, 0).toLongLong();
+        segment.path    = dir.filePath(name.section('.', 0, 0));
+        segment.size    = QFileInfo(dir.filePath(name)).size();
+        log.segments.push_back(std::move(segment));
+    }
+    if (log.segments.empty()) {
+        return;
+    }
+
+    // the last segment may end with a record torn by a crash, it is rescanned and gets a fresh index
+    Segment& last          = log.segments.back();
+    const qint64 validSize = buildIndex(last.path, indexInterval, [&log, &groupName](const QByteArray& payload) {
+        log.tail.push_back(decodeRecord(groupName, payload));
+        if (log.tail.size() > tailSize) {
+            log.tail.pop_front();
+        }
+    });
+    if (validSize != last.size) {
+        QFile file(last.path + ".log");
+        file.resize(validSize);
+        last.size = validSize;
+        Metrics::increment("log.truncated");
+    }
+    if (last.size == 0) {
+        QFile::remove(last.path + ".log");
+        QFile::remove(last.path + ".idx");
+        log.segments.pop_back();
+    }
+
+    for (Segment& segment : log.segments) {
+        if (!QFile::exists(segment.path + ".idx")) {
+            buildIndex(segment.path, indexInterval);
+        }
+        mapIndex(segment);
+    }
+    if (!log.tail.empty()) {
+        log.lastId = log.tail.back().getId();
+    } else if (!log.segments.empty()) {
+        log.lastId = lastRecordId(log.segments.back().path);
+    }
+}
+
+bool MessageLog::startSegment(GroupLog& log, const qint64 firstId)
+{
+    Segment segment;
+    segment.firstId = firstId;
+    segment.path    = log.directory + QString("/") + segmentName(firstId);
+
+    auto active      = std::make_unique<QFile>(segment.path + ".log");
+    auto activeIndex = std::make_unique<QFile>(segment.path + ".idx");
+    if (!active->open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+        !activeIndex->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << qPrintable(QString("unable to create segment: %1").arg(active->errorString()));
+        return false;
+    }
+    log.active      = std::move(active);
+    log.activeIndex = std::move(activeIndex);
+    log.segments.push_back(std::move(segment));
+    log.liveIndex.clear();
+    log.unindexedBytes = 0;
+    Metrics::increment("log.segments");
+    return true;
+}
+
+void MessageLog::seal(GroupLog& log)
+{
+    if (!log.active) {
+        return;
+    }
+    if (fsyncPolicy != FsyncPolicy::Never) {
+        syncFile(*log.active);
+    }
+    log.active->close();
+    log.activeIndex->close();
+    log.active.reset();
+    log.activeIndex.reset();
+    log.liveIndex.clear();
+    log.dirty = false;
+    mapIndex(log.segments.back());
+}
+
+bool MessageLog::mapIndex(Segment& segment)
+{
+    segment.index      = nullptr;
+    segment.indexCount = 0;
+    segment.indexFile  = std::make_unique<QFile>(segment.path + ".idx");
+    if (!segment.indexFile->open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const qint64 count = segment.indexFile->size() / indexEntrySize;
+    if (count == 0) {
+        return true;
+    }
+    segment.index = segment.indexFile->map(0, count * indexEntrySize);
+    if (segment.index) {
+        segment.indexCount = count;
+    }
+    return segment.index != nullptr;
+}
+
+/* offset of the last indexed record with an id not above the given one */
+qint64 MessageLog::findOffset(const GroupLog& log, const Segment& segment, const qint64 id)
+{
+    const bool live    = log.active && &segment == &log.segments.back();
+    const qint64 count = live ? log.liveIndex.size() : segment.indexCount;
+    const auto entryAt = [&](const qint64 i, const int field) {
+        if (live) {
+            const IndexEntry& entry = log.liveIndex.at(static_cast<int>(i));
+            return field == 0 ? entry.id : entry.offset;
+        }
+        return qFromLittleEndian<qint64>(segment.index + i * indexEntrySize + field * sizeof(qint64));
+    };
+
+    qint64 low  = 0;
+    qint64 high = count;
+    while (low < high) {
+        const qint64 middle = low + (high - low) / 2;
+        if (entryAt(middle, 0) <= id) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low == 0 ? 0 : entryAt(low - 1, 1);
+}
+
+qint64 MessageLog::append(const Message& message)
+{
+    GroupLog& log   = open(message.getGroupName());
+    const qint64 id = log.lastId + 1;
+    if (log.active && log.segments.back().size >= segmentSize) {
+        seal(log);
+    }
+    if (!log.active && !startSegment(log, id)) {
+        return 0;
+    }
+
+    Segment& segment         = log.segments.back();
+    const QByteArray payload = encodePayload(id, message);
+    if (log.liveIndex.isEmpty() || log.unindexedBytes >= indexInterval) {
+        writeIndexEntry(*log.activeIndex, id, segment.size);
+        log.activeIndex->flush();
+        log.liveIndex.push_back({id, segment.size});
+        log.unindexedBytes = 0;
+    }
+    const QByteArray record = encodeRecord(payload);
+    if (log.active->write(record) != record.size() || !log.active->flush()) {
+        // never append behind a partial record, the next message opens a new segment
+        qWarning() << qPrintable(QString("unable to append message: %1").arg(log.active->errorString()));
+        seal(log);
+        return 0;
+    }
+    segment.size += record.size();
+    log.unindexedBytes += record.size();
+    if (fsyncPolicy == FsyncPolicy::Always) {
+        syncFile(*log.active);
+    } else {
+        log.dirty = true;
+    }
+
+    log.lastId = id;
+    Message stored = message;
+    stored.setId(id);
+    log.tail.push_back(stored);
+    if (log.tail.size() > tailSize) {
+        log.tail.pop_front();
+    }
+    Metrics::increment("log.appended");
+    return id;
+}
+
+QList<Message> MessageLog::fetch(const QString& groupName, const qint64 afterId)
+{
+    GroupLog& log = open(groupName);
+    QList<Message> messages;
+    if (afterId >= log.lastId) {
+        return messages;
+    }
+
+    // recent history is served from memory
+    if (!log.tail.empty() && afterId >= log.tail.front().getId() - 1) {
+        for (const Message& message : log.tail) {
+            if (message.getId() > afterId) {
+                messages.push_back(message);
+            }
+        }
+        Metrics::increment("log.tail_hits");
+        return messages;
+    }
+
+    Metrics::increment("log.disk_reads");
+    auto segment = std::upper_bound(log.segments.begin(), log.segments.end(), afterId + 1,
+                                    [](const qint64 id, const Segment& candidate) { return id < candidate.firstId; });
+    if (segment != log.segments.begin()) {
+        --segment;
+    }
+    for (; segment != log.segments.end(); ++segment) {
+        QFile file(segment->path + ".log");
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << qPrintable(QString("unable to read segment: %1").arg(file.errorString()));
+            break;
+        }
+        scanSegment(file, findOffset(log, *segment, afterId + 1), [&](qint64, const QByteArray& payload) {
+            if (recordId(payload) > afterId) {
+                messages.push_back(decodeRecord(groupName, payload));
+            }
+        });
+    }
+    return messages;
+}
+
+QList<Message> MessageLog::fetchIds(const QString& groupName, const QVector<qint64>& ids)
+{
+    GroupLog& log = open(groupName);
+    QList<Message> messages;
+    const Segment* opened = nullptr;
+    QFile file;
+    for (const qint64 id : ids) {
+        if (id <= 0 || id > log.lastId) {
+            continue;
+        }
+        if (!log.tail.empty() && id >= log.tail.front().getId()) {
+            messages.push_back(log.tail[static_cast<size_t>(id - log.tail.front().getId())]);
+            continue;
+        }
+
+        auto segment = std::upper_bound(
+            log.segments.cbegin(), log.segments.cend(), id,
+            [](const qint64 wanted, const Segment& candidate) { return wanted < candidate.firstId; });
+        if (segment == log.segments.cbegin()) {
+            continue;
+        }
+        --segment;
+        if (opened != &*segment) {
+            file.close();
+            file.setFileName(segment->path + ".log");
+            if (!file.open(QIODevice::ReadOnly)) {
+                qWarning() << qPrintable(QString("unable to read segment: %1").arg(file.errorString()));
+                opened = nullptr;
+                continue;
+            }
+            opened = &*segment;
+        }
+        // the index lands at most indexInterval bytes before the record
+        Metrics::increment("log.disk_reads");
+        file.seek(findOffset(log, *segment, id));
+        QByteArray payload;
+        while (readRecord(file, payload)) {
+            const qint64 recordedId = recordId(payload);
+            if (recordedId >= id) {
+                if (recordedId == id) {
+                    messages.push_back(decodeRecord(groupName, payload));
+                }
+                break;
+            }
+        }
+    }
+    return messages;
+}
+
+QList<Message> MessageLog::fetchRange(const QString& groupName, const qint64 from, const qint64 to,
+                                      const qint64 afterId, const int limit)
+{
+    GroupLog& log = open(groupName);
+    const auto stampOf = [&](const qint64 id) {
+        const QList<Message> found = fetchIds(groupName, {id});
+        return found.isEmpty() ? 0 : found.first().getTimestamp();
+    };
+
+    // ids are contiguous and the server stamps in order, the first id at or after from is found by bisection
+    qint64 low  = 1;
+    qint64 high = log.lastId + 1;
+    while (low < high) {
+        const qint64 middle = low + (high - low) / 2;
+        if (stampOf(middle) < from) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    QList<Message> messages;
+    for (qint64 first = low; first <= log.lastId && messages.size() < limit; first += limit) {
+        QVector<qint64> ids;
+        for (qint64 id = first; id <= log.lastId && id < first + limit; ++id) {
+            ids.push_back(id);
+        }
+        for (const Message& message : fetchIds(groupName, ids)) {
+            if (message.getTimestamp() >= to) {
+                return messages;
+            }
+            if ((message.getTimestamp() > from || message.getId() > afterId) && messages.size() < limit) {
+                messages.push_back(message);
+            }
+        }
+    }
+    return messages;
+}
+
+void MessageLog::sync()
+{
+    for (auto& group : groups) {
+        GroupLog& log = group.second;
+        if (log.dirty && log.active) {
+            syncFile(*log.active);
+            log.dirty = false;
+        }
+    }
+}
+
+/* restarts and rolls leave small sealed segments behind, runs of them are merged into one */
+void MessageLog::compact()
+{
+    for (auto& group : groups) {
+        GroupLog& log = group.second;
+        if (log.compacting) {
+            continue;
+        }
+        const size_t sealedCount = log.active ? log.segments.size() - 1 : log.segments.size();
+        QVector<qint64> mergedIds;
+        QStringList paths;
+        qint64 total = 0;
+        for (size_t i = 0; i < sealedCount; ++i) {
+            const Segment& segment = log.segments.at(i);
+            const bool small       = segment.size < segmentSize / 4;
+            if (small && total + segment.size <= segmentSize) {
+                mergedIds.push_back(segment.firstId);
+                paths.push_back(segment.path);
+                total += segment.size;
+                continue;
+            }
+            if (mergedIds.size() >= 2) {
+                break;
+            }
+            mergedIds.clear();
+            paths.clear();
+            total = 0;
+            if (small) {
+                mergedIds.push_back(segment.firstId);
+                paths.push_back(segment.path);
+                total = segment.size;
+            }
+        }
+        if (mergedIds.size() < 2) {
+            continue;
+        }
+
+        log.compacting          = true;
+        const QString groupName = group.first;
+        compactionPool.start(new CompactionTask([this, groupName, mergedIds, paths] {
+            const bool success = mergeSegments(paths, paths.first(), indexInterval);
+            QTimer::singleShot(0, this, [this, groupName, mergedIds, success] {
+                finishCompaction(groupName, mergedIds, success);
+            });
+        }));
+        return; // one merge at a time
+    }
+}
+
+void MessageLog::finishCompaction(const QString& groupName, const QVector<qint64>& mergedIds, const bool success)
+{
+    GroupLog& log        = open(groupName);
+    log.compacting       = false;
+    const QString target = log.directory + QString("/") + segmentName(mergedIds.first());
+    if (!success) {
+        QFile::remove(target + ".compact.log");
+        QFile::remove(target + ".compact.idx");
+        QFile::remove(target + ".merged.log");
+        Metrics::increment("log.compaction_failures");
+        return;
+    }
+
+    const qint64 firstId = mergedIds.first();
+    const auto first     = std::find_if(log.segments.begin(), log.segments.end(),
+                                        [firstId](const Segment& segment) { return segment.firstId == firstId; });
+    const auto last      = first + mergedIds.size();
+    for (auto it = first; it != last; ++it) {
+        it->indexFile.reset();
+        it->index      = nullptr;
+        it->indexCount = 0;
+        if (it != first) {
+            QFile::remove(it->path + ".log");
+            QFile::remove(it->path + ".idx");
+        }
+    }
+    QFile::remove(target + ".log");
+    QFile::remove(target + ".idx");
+    QFile::rename(target + ".merged.log", target + ".log");
+    QFile::rename(target + ".compact.idx", target + ".idx");
+
+    first->size = QFileInfo(target + ".log").size();
+    log.segments.erase(first + 1, last);
+    mapIndex(*first);
+    Metrics::increment("log.compactions");
+}
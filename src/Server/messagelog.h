@@ -0,0 +1,90 @@
+#ifndef MESSAGE_LOG_H
+#define MESSAGE_LOG_H
+
+#include <QObject>
+#include <QFile>
+#include <QTimer>
+#include <QVector>
+#include <QThreadPool>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#include "message.h"
+
+/* embedded message storage: per group append-only segment files with a sparse (id, offset) index,
+ * the index of a sealed segment is mmap'd and recent messages are kept in memory */
+class MessageLog : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(MessageLog)
+public:
+    enum class FsyncPolicy
+    {
+        Never,    // leave it to the OS
+        Interval, // once per syncInterval
+        Always    // before append() returns
+    };
+
+    MessageLog(const QString& directory, FsyncPolicy fsyncPolicy, QObject* parent = nullptr);
+    ~MessageLog() override;
+    qint64 append(const Message& message);
+    QList<Message> fetch(const QString& groupName, qint64 afterId);
+    /* ids in ascending order, unknown ones are skipped */
+    QList<Message> fetchIds(const QString& groupName, const QVector<qint64>& ids);
+    /* messages stamped in [from, to) after (from, afterId), found by bisecting the ids */
+    QList<Message> fetchRange(const QString& groupName, qint64 from, qint64 to, qint64 afterId, int limit);
+    static FsyncPolicy fsyncPolicyFromString(const QString& name);
+
+private slots:
+    void sync();
+    void compact();
+
+private:
+    struct IndexEntry {
+        qint64 id;
+        qint64 offset;
+    };
+    struct Segment {
+        qint64 firstId = 0;
+        qint64 size    = 0;
+        QString path; // without extension
+        std::unique_ptr<QFile> indexFile;
+        const uchar* index = nullptr; // mapped entries of a sealed segment
+        qint64 indexCount  = 0;
+    };
+    struct GroupLog {
+        QString directory;
+        std::vector<Segment> segments;
+        std::unique_ptr<QFile> active; // last segment while it takes appends
+        std::unique_ptr<QFile> activeIndex;
+        QVector<IndexEntry> liveIndex;
+        qint64 lastId         = 0;
+        qint64 unindexedBytes = 0;
+        std::deque<Message> tail;
+        bool dirty      = false;
+        bool compacting = false;
+    };
+    GroupLog& open(const QString& groupName);
+    void recover(GroupLog& log, const QString& groupName);
+    bool startSegment(GroupLog& log, qint64 firstId);
+    void seal(GroupLog& log);
+    void finishCompaction(const QString& groupName, const QVector<qint64>& mergedIds, bool success);
+    static bool mapIndex(Segment& segment);
+    static qint64 findOffset(const GroupLog& log, const Segment& segment, qint64 id);
+
+private:
+    const QString directory;
+    const FsyncPolicy fsyncPolicy;
+    std::map<QString, GroupLog> groups;
+    QTimer* syncTimer;
+    QTimer* compactionTimer;
+    QThreadPool compactionPool;
+    static constexpr qint64 segmentSize     = 16 * 1024 * 1024;
+    static constexpr qint64 indexInterval   = 4096; // bytes of log between index entries
+    static constexpr size_t tailSize        = 1000;
+    static constexpr int syncInterval       = 1000;
+    static constexpr int compactionInterval = 1000 * 60;
+};
+
+#endif // MESSAGE_LOG_H
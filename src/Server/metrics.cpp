@@ -0,0 +1,33 @@
+#include <QDebug>
+#include "metrics.h"
+
+void Metrics::increment(const QString& name, const qint64 value)
+{
+    QMutexLocker locker(&mutex);
+    values[name] += value;
+}
+
+void Metrics::set(const QString& name, const qint64 value)
+{
+    QMutexLocker locker(&mutex);
+    values[name] = value;
+}
+
+QMap<QString, qint64> Metrics::snapshot()
+{
+    QMutexLocker locker(&mutex);
+    return values;
+}
+
+void Metrics::report()
+{
+    const QMap<QString, qint64> current = snapshot();
+    if (current.isEmpty()) {
+        return;
+    }
+    QString text("metrics:");
+    for (auto it = current.cbegin(); it != current.cend(); ++it) {
+        text += QString("\n    %1 = %2").arg(it.key()).arg(it.value());
+    }
+    qInfo() << qPrintable(text);
+}
@@ -0,0 +1,21 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QMap>
+#include <QMutex>
+#include <QString>
+
+class Metrics
+{
+public:
+    static void increment(const QString& name, qint64 value = 1);
+    static void set(const QString& name, qint64 value);
+    static QMap<QString, qint64> snapshot();
+    static void report();
+
+private:
+    static inline QMutex mutex{};
+    static inline QMap<QString, qint64> values{};
+};
+
+#endif // METRICS_H
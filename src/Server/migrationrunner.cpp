@@ -0,0 +1,107 @@
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSqlError>
+#include <QSqlQuery>
+#include "migrationrunner.h"
+
+bool MigrationRunner::migrate(QSqlDatabase connection, const QString& dialect)
+{
+    QSqlQuery query(connection);
+    if (!query.exec(R"(create table if not exists schema_version
+(
+    version    integer primary key,
+    applied_at bigint not null
+))")) {
+        qCritical() << qPrintable(QString("unable to create schema_version: %1").arg(query.lastError().text()));
+        return false;
+    }
+
+    const QDir directory(QString(":/migrations/%1").arg(dialect));
+    const QStringList scripts = directory.entryList({"*.sql"}, QDir::Files, QDir::Name);
+    if (scripts.isEmpty()) {
+        qCritical() << qPrintable(QString("no migrations bundled for %1").arg(dialect));
+        return false;
+    }
+    int version = currentVersion(connection);
+    for (const QString& script : scripts) {
+        const int scriptVersion = script.section('_', 0, 0).toInt();
+        if (scriptVersion <= version) {
+            continue;
+        }
+        if (!apply(connection, dialect, directory.filePath(script), scriptVersion)) {
+            return false;
+        }
+        qInfo() << qPrintable(QString("applied migration %1").arg(script));
+        version = scriptVersion;
+    }
+    return true;
+}
+
+int MigrationRunner::currentVersion(QSqlDatabase& connection)
+{
+    QSqlQuery query(connection);
+    int version = 0;
+    if (query.exec("select max(version) from schema_version") && query.next()) {
+        version = query.value(0).toInt();
+    }
+    return version;
+}
+
+bool MigrationRunner::apply(QSqlDatabase& connection, const QString& dialect, const QString& path,
+                            const int version)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qCritical() << qPrintable(QString("unable to read %1: %2").arg(path, file.errorString()));
+        return false;
+    }
+    const QStringList scriptStatements = statements(QString::fromUtf8(file.readAll()));
+
+    connection.transaction();
+    QSqlQuery query(connection);
+    // another server starting against the same database waits here and then finds the script applied
+    if (dialect == QLatin1String("postgres")) {
+        query.exec("lock table schema_version in exclusive mode");
+    }
+    if (currentVersion(connection) >= version) {
+        connection.rollback();
+        return true;
+    }
+    for (const QString& statement : scriptStatements) {
+        if (!query.exec(statement)) {
+            qCritical() << qPrintable(QString("migration %1 failed: %2").arg(path, query.lastError().text()));
+            connection.rollback();
+            return false;
+        }
+    }
+    query.prepare("insert into schema_version (version, applied_at) values (:version, :applied_at)");
+    query.bindValue(":version", version);
+    query.bindValue(":applied_at", QDateTime::currentMSecsSinceEpoch());
+    if (!query.exec() || !connection.commit()) {
+        qCritical() << qPrintable(QString("unable to record migration %1: %2").arg(path, query.lastError().text()));
+        connection.rollback();
+        return false;
+    }
+    return true;
+}
+
+/* drivers run one statement per exec, scripts keep semicolons out of literals and comments */
+QStringList MigrationRunner::statements(const QString& script)
+{
+    QStringList lines;
+    for (const QString& line : script.split('\n')) {
+        const int comment = line.indexOf(QLatin1String("--"));
+        lines.push_back(comment < 0 ? line : line.left(comment));
+    }
+
+    QStringList result;
+    for (const QString& statement : lines.join('\n').split(';')) {
+        const QString trimmed = statement.trimmed();
+        if (!trimmed.isEmpty()) {
+            result.push_back(trimmed);
+        }
+    }
+    return result;
+}
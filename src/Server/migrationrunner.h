@@ -0,0 +1,20 @@
+#ifndef MIGRATION_RUNNER_H
+#define MIGRATION_RUNNER_H
+
+#include <QSqlDatabase>
+#include <QStringList>
+
+/* brings a database up to the newest schema with the scripts bundled under :/migrations/<dialect>,
+ * a script is named <version>_<what it does>.sql and runs in its own transaction */
+class MigrationRunner
+{
+public:
+    static bool migrate(QSqlDatabase connection, const QString& dialect);
+
+private:
+    static int currentVersion(QSqlDatabase& connection);
+    static bool apply(QSqlDatabase& connection, const QString& dialect, const QString& path, int version);
+    static QStringList statements(const QString& script);
+};
+
+#endif // MIGRATION_RUNNER_H
@@ -0,0 +1,3 @@
+#include "packetlog.h"
+
+Q_LOGGING_CATEGORY(lcPackets, "messenger.packets", QtInfoMsg)
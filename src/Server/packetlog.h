@@ -0,0 +1,9 @@
+#ifndef PACKET_LOG_H
+#define PACKET_LOG_H
+
+#include <QLoggingCategory>
+
+/* every packet sent and received, debug only and off by default: QT_LOGGING_RULES="messenger.packets.debug=true" */
+Q_DECLARE_LOGGING_CATEGORY(lcPackets)
+
+#endif // PACKET_LOG_H
@@ -0,0 +1,49 @@
+#include "presencebatcher.h"
+#include "metrics.h"
+
+PresenceBatcher::PresenceBatcher(const int interval, QObject* parent) : QObject(parent), tickTimer(new QTimer(this))
+{
+    tickTimer->setSingleShot(true);
+    tickTimer->setInterval(interval);
+    connect(tickTimer, &QTimer::timeout, this, &PresenceBatcher::flush);
+}
+
+void PresenceBatcher::joined(const QString& groupName, const QString& userName)
+{
+    Delta& delta = deltas[groupName];
+    // left and came back inside one tick, nothing changed for the others
+    if (!delta.left.remove(userName)) {
+        delta.joined.insert(userName);
+    } else {
+        Metrics::increment("presence.collapsed");
+    }
+    if (!tickTimer->isActive()) {
+        tickTimer->start();
+    }
+}
+
+void PresenceBatcher::left(const QString& groupName, const QString& userName)
+{
+    Delta& delta = deltas[groupName];
+    if (!delta.joined.remove(userName)) {
+        delta.left.insert(userName);
+    } else {
+        Metrics::increment("presence.collapsed");
+    }
+    if (!tickTimer->isActive()) {
+        tickTimer->start();
+    }
+}
+
+void PresenceBatcher::flush()
+{
+    const QHash<QString, Delta> ready = std::move(deltas);
+    deltas.clear();
+    for (auto it = ready.cbegin(); it != ready.cend(); ++it) {
+        if (it->joined.isEmpty() && it->left.isEmpty()) {
+            continue;
+        }
+        Metrics::increment("presence.deltas");
+        emit deltaReadySig(it.key(), it->joined.values(), it->left.values());
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef PRESENCE_BATCHER_H
+#define PRESENCE_BATCHER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+
+/* collects joins and leaves per group and hands them out once per tick,
+ * a join followed by a leave of the same user inside one tick cancels out */
+class PresenceBatcher : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(PresenceBatcher)
+public:
+    explicit PresenceBatcher(int interval, QObject* parent = nullptr);
+    void joined(const QString& groupName, const QString& userName);
+    void left(const QString& groupName, const QString& userName);
+
+private slots:
+    void flush();
+signals:
+    void deltaReadySig(const QString& groupName, const QStringList& joined, const QStringList& left);
+
+private:
+    struct Delta {
+        QSet<QString> joined;
+        QSet<QString> left;
+    };
+    QHash<QString, Delta> deltas;
+    QTimer* tickTimer;
+};
+
+#endif // PRESENCE_BATCHER_H
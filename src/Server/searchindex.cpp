@@ -0,0 +1,253 @@
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <algorithm>
+#include <iterator>
+#include "searchindex.h"
+#include "constants.h"
+#include "db.h"
+#include "metrics.h"
+
+namespace {
+    constexpr quint32 indexMagic   = 0x53494458; // "SIDX"
+    constexpr quint32 indexVersion = 1;
+
+    void writeVarint(QByteArray& out, quint64 value)
+    {
+        while (value >= 0x80) {
+            out.append(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.append(static_cast<char>(value));
+    }
+
+    QVector<qint64> intersect(const QVector<qint64>& left, const QVector<qint64>& right)
+    {
+        QVector<qint64> result;
+        std::set_intersection(left.cbegin(), left.cend(), right.cbegin(), right.cend(), std::back_inserter(result));
+        return result;
+    }
+} // namespace
+
+SearchIndex::SearchIndex(const QString& directory, QObject* parent)
+    : QObject(parent), directory(directory), saveTimer(new QTimer(this))
+{
+    if (directory.isEmpty()) {
+        return;
+    }
+    if (!QDir().mkpath(directory)) {
+        qWarning() << qPrintable(QString("unable to create search index directory %1").arg(directory));
+    }
+    connect(saveTimer, &QTimer::timeout, this, &SearchIndex::save);
+    saveTimer->start(saveInterval);
+}
+
+SearchIndex::~SearchIndex()
+{
+    save();
+}
+
+QStringList SearchIndex::tokenize(const QString& text)
+{
+    QStringList terms;
+    QString term;
+    const auto flush = [&] {
+        if (term.size() >= minTermLength && term.size() <= maxTermLength) {
+            terms.push_back(term);
+        }
+        term.clear();
+    };
+    for (const QChar character : text.toCaseFolded()) {
+        if (character.isLetterOrNumber()) {
+            term.append(character);
+        } else {
+            flush();
+        }
+    }
+    flush();
+    return terms;
+}
+
+void SearchIndex::add(const QString& groupName, const qint64 id, const QString& text)
+{
+    // a freshly opened group already picked the message up from the storage
+    insert(open(groupName), id, text);
+}
+
+SearchIndex::Page SearchIndex::search(const QString& groupName, const QString& query, const qint64 beforeId,
+                                      const int limit)
+{
+    Metrics::increment("search.queries");
+    Page page;
+    QStringList terms = tokenize(query);
+    terms.removeDuplicates();
+    if (terms.isEmpty() || limit <= 0) {
+        return page;
+    }
+    terms = terms.mid(0, maxQueryTerms);
+
+    const GroupIndex& index = open(groupName);
+    QVector<QVector<qint64>> postings;
+    for (const QString& term : terms) {
+        const auto list = index.terms.constFind(term);
+        if (list == index.terms.constEnd()) {
+            return page;
+        }
+        postings.push_back(decode(*list));
+    }
+    // the shortest list bounds the result, intersect from it
+    std::sort(postings.begin(), postings.end(),
+              [](const QVector<qint64>& left, const QVector<qint64>& right) { return left.size() < right.size(); });
+    QVector<qint64> matches = postings.first();
+    for (int i = 1; i < postings.size() && !matches.isEmpty(); ++i) {
+        matches = intersect(matches, postings.at(i));
+    }
+
+    auto end = beforeId > 0 ? std::lower_bound(matches.cbegin(), matches.cend(), beforeId) : matches.cend();
+    while (end != matches.cbegin() && page.ids.size() < limit) {
+        --end;
+        page.ids.push_back(*end);
+    }
+    page.hasMore = end != matches.cbegin();
+    return page;
+}
+
+SearchIndex::GroupIndex& SearchIndex::open(const QString& groupName)
+{
+    auto found = groups.find(groupName);
+    if (found != groups.end()) {
+        return found->second;
+    }
+
+    GroupIndex& index = groups[groupName];
+    if (!directory.isEmpty() && QFile::exists(indexPath(groupName)) && !load(index, groupName)) {
+        qWarning() << qPrintable(QString("rebuilding search index of %1").arg(groupName));
+        index = GroupIndex();
+    }
+    // catch up with messages stored since the index was saved
+    const QList<Message> missed = db::fetchMessages(groupName, index.lastId);
+    for (const Message& message : missed) {
+        insert(index, message.getId(), message.getMessage().toString());
+    }
+    Metrics::increment("search.loaded");
+    return index;
+}
+
+bool SearchIndex::load(GroupIndex& index, const QString& groupName) const
+{
+    QFile file(indexPath(groupName));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << qPrintable(QString("unable to read search index: %1").arg(file.errorString()));
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(SERIALIZER_VERSION);
+    quint32 magic   = 0;
+    quint32 version = 0;
+    quint32 count   = 0;
+    stream >> magic >> version;
+    if (magic != indexMagic || version != indexVersion) {
+        return false;
+    }
+    stream >> index.lastId >> count;
+    index.terms.reserve(static_cast<int>(qMin<quint32>(count, 1u << 20)));
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString term;
+        PostingList list;
+        stream >> term >> list.lastId >> list.deltas;
+        index.terms.insert(term, list);
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+bool SearchIndex::store(const GroupIndex& index, const QString& groupName) const
+{
+    QSaveFile file(indexPath(groupName));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << qPrintable(QString("unable to write search index: %1").arg(file.errorString()));
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(SERIALIZER_VERSION);
+    // posting lists are written as they are kept, already compressed
+    stream << indexMagic << indexVersion << index.lastId << static_cast<quint32>(index.terms.size());
+    for (auto term = index.terms.cbegin(); term != index.terms.cend(); ++term) {
+        stream << term.key() << term->lastId << term->deltas;
+    }
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+void SearchIndex::save()
+{
+    if (directory.isEmpty()) {
+        return;
+    }
+    for (auto& group : groups) {
+        if (group.second.dirty && store(group.second, group.first)) {
+            group.second.dirty = false;
+        }
+    }
+}
+
+QString SearchIndex::indexPath(const QString& groupName) const
+{
+    return directory + QString("/") + QString::fromLatin1(groupName.toUtf8().toHex()) + QString(".idx");
+}
+
+void SearchIndex::insert(GroupIndex& index, const qint64 id, const QString& text)
+{
+    QStringList terms = tokenize(text);
+    terms.removeDuplicates();
+    for (const QString& term : terms) {
+        append(index.terms[term], id);
+    }
+    index.lastId = qMax(index.lastId, id);
+    index.dirty  = true;
+    Metrics::increment("search.indexed");
+}
+
+void SearchIndex::append(PostingList& list, const qint64 id)
+{
+    if (id > list.lastId) {
+        writeVarint(list.deltas, static_cast<quint64>(id - list.lastId));
+        list.lastId = id;
+        return;
+    }
+    if (id == list.lastId) {
+        return;
+    }
+
+    // a message of another node may arrive after a newer one, re-encode the list around it
+    QVector<qint64> ids = decode(list);
+    const auto position = std::lower_bound(ids.begin(), ids.end(), id);
+    if (position != ids.end() && *position == id) {
+        return;
+    }
+    ids.insert(position, id);
+    list = PostingList();
+    for (const qint64 each : ids) {
+        append(list, each);
+    }
+}
+
+QVector<qint64> SearchIndex::decode(const PostingList& list)
+{
+    QVector<qint64> ids;
+    qint64 id     = 0;
+    quint64 delta = 0;
+    int shift     = 0;
+    for (const char byte : list.deltas) {
+        delta |= static_cast<quint64>(byte & 0x7f) << shift;
+        if (byte & 0x80) {
+            shift += 7;
+            continue;
+        }
+        id += static_cast<qint64>(delta);
+        ids.push_back(id);
+        delta = 0;
+        shift = 0;
+    }
+    return ids;
+}
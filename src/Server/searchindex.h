@@ -0,0 +1,60 @@
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+#include <QVector>
+#include <map>
+
+/* per group inverted index over message text, posting lists hold varint encoded id deltas,
+ * a group is loaded on first use and indexes whatever the storage got since it was last saved */
+class SearchIndex : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(SearchIndex)
+public:
+    struct Page {
+        QVector<qint64> ids; // newest first
+        bool hasMore = false;
+    };
+
+    explicit SearchIndex(const QString& directory, QObject* parent = nullptr);
+    ~SearchIndex() override;
+    void add(const QString& groupName, qint64 id, const QString& text);
+    /* messages matching every term of the query with an id below beforeId, 0 starts from the newest */
+    Page search(const QString& groupName, const QString& query, qint64 beforeId, int limit);
+    static QStringList tokenize(const QString& text);
+
+private slots:
+    void save();
+
+private:
+    struct PostingList {
+        QByteArray deltas;
+        qint64 lastId = 0;
+    };
+    struct GroupIndex {
+        QHash<QString, PostingList> terms;
+        qint64 lastId = 0;
+        bool dirty    = false;
+    };
+    GroupIndex& open(const QString& groupName);
+    bool load(GroupIndex& index, const QString& groupName) const;
+    bool store(const GroupIndex& index, const QString& groupName) const;
+    QString indexPath(const QString& groupName) const;
+    static void insert(GroupIndex& index, qint64 id, const QString& text);
+    static void append(PostingList& list, qint64 id);
+    static QVector<qint64> decode(const PostingList& list);
+
+private:
+    const QString directory; // empty keeps the index in memory only
+    std::map<QString, GroupIndex> groups;
+    QTimer* saveTimer;
+    static constexpr int saveInterval  = 1000 * 30;
+    static constexpr int minTermLength = 2;
+    static constexpr int maxTermLength = 64;
+    static constexpr int maxQueryTerms = 8;
+};
+
+#endif // SEARCH_INDEX_H
@@ -0,0 +1,158 @@
+#include <QCommandLineParser>
+#include <QThread>
+#include <QCoreApplication>
+#include <QHostInfo>
+#include "serverconfig.h"
+
+ServerConfig ServerConfig::fromArguments(const QStringList& arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Messenger server");
+    parser.addHelpOption();
+
+    const QCommandLineOption hashCredentialsOption("hash-credentials", "store new passwords as PBKDF2 hashes");
+    const QCommandLineOption hashIterationsOption("hash-iterations", "PBKDF2 iteration count", "count");
+    const QCommandLineOption authThreadsOption("auth-threads", "threads used for password hashing", "count");
+    const QCommandLineOption authQueueOption("auth-queue", "max pending password hashing jobs", "count");
+    const QCommandLineOption presenceIntervalOption("presence-interval", "ms between presence updates", "ms");
+    const QCommandLineOption portOption("port", "port to listen on", "port");
+    const QCommandLineOption brokerOption("broker", "run the cluster broker on local:<name> or tcp:<host>:<port>",
+                                          "address");
+    const QCommandLineOption clusterOption("cluster", "join the cluster through the broker at <address>", "address");
+    const QCommandLineOption nodeIdOption("node-id", "name of this node in the cluster", "id");
+    const QCommandLineOption reusePortOption("reuse-port", "share the listening port with a newer server process");
+    const QCommandLineOption sessionFileOption("session-file", "file for sessions handed over on drain", "path");
+    const QCommandLineOption drainGraceOption("drain-grace", "ms before drained clients are disconnected", "ms");
+    const QCommandLineOption drainSpreadOption("drain-spread", "ms over which drained clients reconnect", "ms");
+    const QCommandLineOption messageLogOption("message-log", "store messages in an embedded log in <dir>", "dir");
+    const QCommandLineOption fsyncOption("fsync", "message log fsync policy: always, interval or never", "policy");
+    const QCommandLineOption noStatementCacheOption(
+        "no-statement-cache", "prepare every query again instead of reusing it, to measure the statement cache");
+    const QCommandLineOption storageOption("storage", "storage backend: postgres, sqlite or memory", "backend");
+    const QCommandLineOption databaseOption("database", "database name, or file for sqlite", "name");
+    const QCommandLineOption searchIndexOption("search-index", "directory the search index is saved to", "dir");
+    const QCommandLineOption fileDirOption("file-dir", "directory attachments are stored in, empty disables them",
+                                           "dir");
+    const QCommandLineOption maxFileSizeOption("max-file-size", "largest attachment accepted", "MiB");
+    const QCommandLineOption userRateOption(
+        "user-rate", "messages per second one client may post, unlimited by default", "count");
+    const QCommandLineOption userBurstOption("user-burst", "messages one client may post at once, 20 by default",
+                                             "count");
+    const QCommandLineOption groupRateOption(
+        "group-rate", "messages per second posted to one group, unlimited by default", "count");
+    const QCommandLineOption groupBurstOption("group-burst", "messages posted to one group at once, 1000 by default",
+                                              "count");
+    const QCommandLineOption pingIntervalOption("ping-interval", "ms of silence before a client is pinged, 0 - never",
+                                                "ms");
+    const QCommandLineOption idleTimeoutOption("idle-timeout", "ms of silence before a client is dropped", "ms");
+    const QCommandLineOption maxConnectionsOption(
+        "max-connections", "connections accepted at once, unlimited by default", "count");
+    const QCommandLineOption maxUnauthenticatedOption(
+        "max-unauthenticated", "connections not logged in yet accepted at once, unlimited by default", "count");
+    const QCommandLineOption maxPerAddressOption(
+        "max-per-address", "connections from one address, unlimited by default", "count");
+    const QCommandLineOption loginTimeoutOption(
+        "login-timeout", "ms a connection not logged in may stay silent, forever by default", "ms");
+    parser.addOptions({hashCredentialsOption, hashIterationsOption, authThreadsOption, authQueueOption,
+                       presenceIntervalOption, portOption, brokerOption, clusterOption, nodeIdOption,
+                       reusePortOption, sessionFileOption, drainGraceOption, drainSpreadOption, messageLogOption,
+                       fsyncOption, storageOption, databaseOption, searchIndexOption, fileDirOption,
+                       maxFileSizeOption, userRateOption, userBurstOption, groupRateOption, groupBurstOption,
+                       pingIntervalOption, idleTimeoutOption, maxConnectionsOption, maxUnauthenticatedOption,
+                       maxPerAddressOption, loginTimeoutOption, noStatementCacheOption});
+    parser.process(arguments);
+
+    ServerConfig config;
+    config.hashCredentials = parser.isSet(hashCredentialsOption);
+    if (parser.isSet(hashIterationsOption)) {
+        config.hashIterations = qMax(parser.value(hashIterationsOption).toInt(), 1);
+    }
+    if (parser.isSet(authThreadsOption)) {
+        config.authThreads = qMax(parser.value(authThreadsOption).toInt(), 0);
+    }
+    if (config.authThreads == 0) {
+        config.authThreads = qMax(QThread::idealThreadCount() / 2, 1);
+    }
+    if (parser.isSet(authQueueOption)) {
+        config.authQueueDepth = qMax(parser.value(authQueueOption).toInt(), 1);
+    }
+    if (parser.isSet(presenceIntervalOption)) {
+        config.presenceInterval = qMax(parser.value(presenceIntervalOption).toInt(), 0);
+    }
+    if (parser.isSet(portOption)) {
+        config.port = parser.value(portOption).toUShort();
+    }
+    config.brokerAddress  = parser.value(brokerOption);
+    config.clusterAddress = parser.value(clusterOption);
+    config.nodeId         = parser.value(nodeIdOption);
+    if (config.nodeId.isEmpty()) {
+        config.nodeId = QString("%1-%2").arg(QHostInfo::localHostName()).arg(QCoreApplication::applicationPid());
+    }
+    config.reusePort = parser.isSet(reusePortOption);
+    if (parser.isSet(sessionFileOption)) {
+        config.sessionFile = parser.value(sessionFileOption);
+    }
+    if (parser.isSet(drainGraceOption)) {
+        config.drainGrace = qMax(parser.value(drainGraceOption).toInt(), 0);
+    }
+    if (parser.isSet(drainSpreadOption)) {
+        config.drainSpread = qMax(parser.value(drainSpreadOption).toInt(), 1);
+    }
+    config.messageLogDir = parser.value(messageLogOption);
+    if (parser.isSet(fsyncOption)) {
+        config.fsyncPolicy = parser.value(fsyncOption);
+    }
+    config.statementCache = !parser.isSet(noStatementCacheOption);
+    if (parser.isSet(storageOption)) {
+        config.storage = parser.value(storageOption);
+    }
+    config.database = parser.value(databaseOption);
+    if (config.storage == QLatin1String("sqlite") && config.database.isEmpty()) {
+        config.database = "messenger.sqlite";
+    }
+    // ids of the memory backend start over on restart, a saved index would point at other messages
+    if (parser.isSet(searchIndexOption)) {
+        config.searchIndexDir = parser.value(searchIndexOption);
+    } else if (config.storage == QLatin1String("memory") && config.messageLogDir.isEmpty()) {
+        config.searchIndexDir.clear();
+    }
+    if (parser.isSet(fileDirOption)) {
+        config.fileDir = parser.value(fileDirOption);
+    }
+    if (parser.isSet(maxFileSizeOption)) {
+        config.maxFileSize = qMax(parser.value(maxFileSizeOption).toLongLong(), 0LL) * 1024 * 1024;
+    }
+    if (parser.isSet(userRateOption)) {
+        config.userMessageRate = qMax(parser.value(userRateOption).toInt(), 0);
+    }
+    if (parser.isSet(userBurstOption)) {
+        config.userMessageBurst = qMax(parser.value(userBurstOption).toInt(), 1);
+    }
+    if (parser.isSet(groupRateOption)) {
+        config.groupMessageRate = qMax(parser.value(groupRateOption).toInt(), 0);
+    }
+    if (parser.isSet(groupBurstOption)) {
+        config.groupMessageBurst = qMax(parser.value(groupBurstOption).toInt(), 1);
+    }
+    if (parser.isSet(pingIntervalOption)) {
+        config.pingInterval = qMax(parser.value(pingIntervalOption).toInt(), 0);
+    }
+    if (parser.isSet(idleTimeoutOption)) {
+        config.idleTimeout = parser.value(idleTimeoutOption).toInt();
+    }
+    // the pong needs some time to come back
+    config.idleTimeout = qMax(config.idleTimeout, config.pingInterval + 1000);
+    if (parser.isSet(maxConnectionsOption)) {
+        config.maxConnections = qMax(parser.value(maxConnectionsOption).toInt(), 0);
+    }
+    if (parser.isSet(maxUnauthenticatedOption)) {
+        config.maxUnauthenticated = qMax(parser.value(maxUnauthenticatedOption).toInt(), 0);
+    }
+    if (parser.isSet(maxPerAddressOption)) {
+        config.maxPerAddress = qMax(parser.value(maxPerAddressOption).toInt(), 0);
+    }
+    if (parser.isSet(loginTimeoutOption)) {
+        config.loginTimeout = qMax(parser.value(loginTimeoutOption).toInt(), 0);
+    }
+    return config;
+}
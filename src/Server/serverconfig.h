@@ -0,0 +1,43 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <QStringList>
+#include "constants.h"
+
+struct ServerConfig {
+    bool hashCredentials = false;
+    int hashIterations   = 100000;
+    int authThreads      = 0; // 0 - half of the ideal thread count
+    int authQueueDepth   = 256;
+    int presenceInterval = 250; // ms between coalesced presence updates
+    quint16 port         = PORT;
+    QString brokerAddress;  // run the cluster broker in this process
+    QString clusterAddress; // broker this node publishes to
+    QString nodeId;
+    bool reusePort       = false;
+    QString sessionFile  = "sessions.json";
+    int drainGrace       = 30000; // ms before lingering clients are dropped
+    int drainSpread      = 10000; // ms over which drained clients come back
+    QString messageLogDir;        // store messages in the embedded log instead of the database
+    QString fsyncPolicy  = "interval";
+    QString storage      = "postgres";
+    QString database; // database name, or file for sqlite
+    bool statementCache = true; // off prepares every query again, to measure what the cache saves
+    QString searchIndexDir = "search"; // empty keeps the search index in memory
+    QString fileDir        = "files";  // empty turns attachments off
+    qint64 maxFileSize     = 64 * 1024 * 1024;
+    int userMessageRate    = 0; // messages per second one connection may post, 0 - unlimited
+    int userMessageBurst   = 20; // only used once the rate is set
+    int groupMessageRate   = 0; // messages per second posted to one group, 0 - unlimited
+    int groupMessageBurst  = 1000;
+    int pingInterval       = 30000; // ms of silence before a client is pinged, 0 - never
+    int idleTimeout        = 90000; // ms of silence before a client is dropped
+    int maxConnections     = 0; // 0 - unlimited, same for the limits below
+    int maxUnauthenticated = 0; // connections that have not logged in yet, only useful with a login timeout
+    int maxPerAddress      = 0; // clients behind one NAT share an address
+    int loginTimeout       = 0; // ms a logged out connection may stay silent, 0 - forever
+
+    static ServerConfig fromArguments(const QStringList& arguments);
+};
+
+#endif // SERVER_CONFIG_H
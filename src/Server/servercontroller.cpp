@@ -1,12 +1,57 @@
+#include <QCoreApplication>
 #include "servercontroller.h"
 #include "connectionpool.h"
 #include "constants.h"
+#include "metrics.h"
+#ifdef Q_OS_UNIX
+#include <csignal>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
-ServerController::ServerController() : serverCore(new ServerCore()) {}
+namespace {
+    int drainSignalFd[2] = {-1, -1};
+
+    void drainSignalHandler(int)
+    {
+        // only async-signal-safe calls here, the notifier does the rest in the event loop
+        const char byte = 1;
+        (void)::write(drainSignalFd[0], &byte, sizeof(byte));
+    }
+} // namespace
+#endif
+
+ServerController::ServerController(const ServerConfig& config)
+    : port(config.port), reusePort(config.reusePort), serverCore(new ServerCore(config)), broker(nullptr),
+      metricsTimer(new QTimer()), drainNotifier(nullptr)
+{
+    if (!config.brokerAddress.isEmpty()) {
+        broker = new ClusterBroker;
+        if (broker->listen(config.brokerAddress)) {
+            qInfo() << qPrintable(QString("cluster broker listening on %1").arg(config.brokerAddress));
+        } else {
+            qCritical() << "unable to start the cluster broker";
+        }
+    }
+
+    metricsTimer->setInterval(metricsReportInterval);
+    QObject::connect(metricsTimer, &QTimer::timeout, [] { Metrics::report(); });
+    metricsTimer->start();
+
+    QObject::connect(serverCore, &ServerCore::drainedSig, [] {
+        qInfo() << "drain finished";
+        QCoreApplication::quit();
+    });
+    watchDrainSignal();
+}
 
 ServerController::~ServerController()
 {
+    metricsTimer->stop();
+    delete metricsTimer;
+    delete drainNotifier;
     delete serverCore;
+    delete broker;
     ConnectionPool::release();
 }
 
@@ -16,10 +61,67 @@ void ServerController::startServer()
         serverCore->stopServer();
         qInfo() << "server stopped";
     } else {
-        if (!serverCore->listen(QHostAddress::Any, PORT)) {
+        const bool listening = reusePort ? listenReusePort() : serverCore->listen(QHostAddress::Any, port);
+        if (!listening) {
             qCritical() << "unable to start the server";
             return;
         }
         qInfo() << "server started";
     }
 }
+
+/* the new process binds next to the old one, the kernel spreads new connections between both
+ * until the old one is drained */
+bool ServerController::listenReusePort()
+{
+#ifdef Q_OS_UNIX
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    const int enable = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+#ifdef SO_REUSEPORT
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+#endif
+    sockaddr_in address{};
+    address.sin_family      = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port        = htons(port);
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (!serverCore->setSocketDescriptor(fd)) {
+        ::close(fd);
+        return false;
+    }
+    return true;
+#else
+    qWarning() << "port sharing is not supported on this platform";
+    return serverCore->listen(QHostAddress::Any, port);
+#endif
+}
+
+/* SIGUSR2 asks the server to hand its clients over to the next process */
+void ServerController::watchDrainSignal()
+{
+#ifdef Q_OS_UNIX
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, drainSignalFd) != 0) {
+        qWarning() << "unable to watch the drain signal";
+        return;
+    }
+    drainNotifier = new QSocketNotifier(drainSignalFd[1], QSocketNotifier::Read);
+    QObject::connect(drainNotifier, &QSocketNotifier::activated, [this] {
+        char byte;
+        (void)::read(drainSignalFd[1], &byte, sizeof(byte));
+        serverCore->drain();
+    });
+
+    struct sigaction action {};
+    action.sa_handler = drainSignalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    ::sigaction(SIGUSR2, &action, nullptr);
+#endif
+}
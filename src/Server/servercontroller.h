@@ -1,17 +1,31 @@
 #ifndef SERVER_CONTROLLER_H
 #define SERVER_CONTROLLER_H
 
+#include <QTimer>
+#include <QSocketNotifier>
 #include "servercore.h"
+#include "serverconfig.h"
+#include "clusterbroker.h"
 
 class ServerController
 {
 public:
-    ServerController();
+    explicit ServerController(const ServerConfig& config);
     ~ServerController();
     void startServer();
 
 private:
+    bool listenReusePort();
+    void watchDrainSignal();
+
+private:
+    const quint16 port;
+    const bool reusePort;
     ServerCore* serverCore;
+    ClusterBroker* broker;
+    QTimer* metricsTimer;
+    QSocketNotifier* drainNotifier;
+    static constexpr int metricsReportInterval = 1000 * 60;
 };
 
 #endif // SERVER_CONTROLLER_H
@@ -4,19 +4,99 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QTimer>
+#include <QPointer>
+#include <random>
+#include <algorithm>
+#include <limits>
+#include <QDateTime>
+#include <QFileInfo>
 #include "servercore.h"
 #include "db.h"
 #include "constants.h"
 #include "message.h"
+#include "credentials.h"
+#include "metrics.h"
+#include "packetlog.h"
+#ifdef Q_OS_WIN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
-ServerCore::ServerCore(QObject* parent) : QTcpServer(parent), idealThreadCount(qMax(QThread::idealThreadCount(), 1))
+namespace {
+#ifdef Q_OS_WIN
+    using NativeSocket = SOCKET;
+#else
+    using NativeSocket = int;
+#endif
+
+    /* the address a new connection comes from, null when the peer is already gone */
+    QHostAddress peerAddress(const qintptr socketDescriptor)
+    {
+        sockaddr_storage address{};
+        socklen_t size = sizeof(address);
+        if (::getpeername(static_cast<NativeSocket>(socketDescriptor), reinterpret_cast<sockaddr*>(&address), &size)
+            != 0) {
+            return QHostAddress();
+        }
+        return QHostAddress(reinterpret_cast<const sockaddr*>(&address));
+    }
+
+    void closeDescriptor(const qintptr socketDescriptor)
+    {
+#ifdef Q_OS_WIN
+        ::closesocket(static_cast<NativeSocket>(socketDescriptor));
+#else
+        ::close(static_cast<NativeSocket>(socketDescriptor));
+#endif
+    }
+} // namespace
+
+ServerCore::ServerCore(const ServerConfig& config, QObject* parent)
+    : QTcpServer(parent), config(config), idealThreadCount(qMax(QThread::idealThreadCount(), 1)),
+      authPool(new AuthPool(config.authThreads, config.authQueueDepth, config.hashIterations, this)),
+      presence(new PresenceBatcher(config.presenceInterval, this)), cluster(nullptr), sessions(config.sessionFile),
+      messageLog(nullptr), searchIndex(nullptr), files(config.fileDir, config.maxFileSize), draining(false),
+      lastTimestamp(0), wheelTimer(new QTimer(this))
 {
+    if (!db::init(config.storage, config.database, config.statementCache)) {
+        qCritical() << qPrintable(QString("unknown storage backend %1").arg(config.storage));
+    }
+    if (!config.messageLogDir.isEmpty()) {
+        messageLog = new MessageLog(config.messageLogDir, MessageLog::fsyncPolicyFromString(config.fsyncPolicy), this);
+        db::setMessageLog(messageLog);
+    }
+    searchIndex = new SearchIndex(config.searchIndexDir, this);
+    // ids of the memory backend start over on restart, ids of cached messages would mean other messages
+    if (config.storage == QLatin1String("memory") && config.messageLogDir.isEmpty()) {
+        historyEpoch = QString::number(QDateTime::currentMSecsSinceEpoch());
+    }
+    connect(presence, &PresenceBatcher::deltaReadySig, this, &ServerCore::sendPresence);
+    if (!config.clusterAddress.isEmpty()) {
+        cluster = new ClusterNode(config.clusterAddress, config.nodeId, this);
+        // traffic of other nodes only goes to local members
+        connect(cluster, &ClusterNode::packetReceivedSig, this,
+                [this](const QString& groupName, const QJsonObject& packet) {
+                    indexRemoteMessage(packet);
+                    broadcast(groupName, packet, nullptr);
+                });
+        connect(cluster, &ClusterNode::syncRequestedSig, this, &ServerCore::syncGroup);
+        cluster->start();
+    }
     threads.reserve(idealThreadCount);
     threadLoadFactor.reserve(idealThreadCount);
+    throttleClock.start();
+    if (config.pingInterval > 0 || config.loginTimeout > 0) {
+        connect(wheelTimer, &QTimer::timeout, this, &ServerCore::advanceWheels);
+        wheelTimer->start(wheelTick);
+    }
 }
 
 ServerCore::~ServerCore()
 {
+    db::setMessageLog(nullptr);
     for (QThread* singleThread : threads) {
         singleThread->quit();
         singleThread->wait();
@@ -25,9 +105,17 @@ ServerCore::~ServerCore()
 
 void ServerCore::incomingConnection(const qintptr socketDescriptor)
 {
-    auto* worker = new ServerWorker;
-    if (!worker->setSocketDescriptor(socketDescriptor)) {
-        worker->deleteLater();
+    // turned away before a worker and its ssl socket are allocated, a flood only costs an accept and a close
+    if ((config.maxConnections > 0 && clients.size() >= config.maxConnections)
+        || (config.maxUnauthenticated > 0 && unauthenticated.size() >= config.maxUnauthenticated)) {
+        Metrics::increment("admission.rejected");
+        closeDescriptor(socketDescriptor);
+        return;
+    }
+    const QHostAddress address = peerAddress(socketDescriptor);
+    if (address.isNull() || !isAdmitted(address)) {
+        Metrics::increment("admission.rejected_address");
+        closeDescriptor(socketDescriptor);
         return;
     }
 
@@ -35,6 +123,11 @@ void ServerCore::incomingConnection(const qintptr socketDescriptor)
     if (threadIdx < idealThreadCount) {
         threads.append(new QThread(this));
         threadLoadFactor.append(1);
+        auto* context = new QObject;
+        context->moveToThread(threads.last());
+        connect(threads.last(), &QThread::finished, context, &QObject::deleteLater);
+        threadContexts.append(context);
+        idleWorkers.append({});
         threads.last()->start();
     } else {
         threadIdx = static_cast<int>(std::distance(threadLoadFactor.begin(),
@@ -42,17 +135,41 @@ void ServerCore::incomingConnection(const qintptr socketDescriptor)
         ++threadLoadFactor[threadIdx];
     }
 
-    worker->moveToThread(threads.at(threadIdx));
-    connect(threads.at(threadIdx), &QThread::finished, worker, &QObject::deleteLater);
+    ServerWorker* worker = nullptr;
+    if (!idleWorkers[threadIdx].isEmpty()) {
+        worker = idleWorkers[threadIdx].takeLast();
+        Metrics::increment("workers.reused");
+    } else {
+        worker = new ServerWorker;
+        worker->moveToThread(threads.at(threadIdx));
+        connect(threads.at(threadIdx), &QThread::finished, worker, &QObject::deleteLater);
+        Metrics::increment("workers.created");
+    }
     connect(worker, &ServerWorker::disconnectedFromClientSig, this,
             [this, worker, threadIdx] { userDisconnected(worker, threadIdx); });
 
     connect(worker, &ServerWorker::errorSig, this, [worker] { userError(worker); });
+    connect(worker, &ServerWorker::fileReceivedSig, this,
+            [this, worker](const QByteArray& hash, const bool valid) { fileReceived(worker, hash, valid); });
     connect(worker, &ServerWorker::packetReceivedSig, this, [this, worker](auto&& placeholder) {
         packetReceived(worker, std::forward<decltype(placeholder)>(placeholder));
     });
     connect(this, &ServerCore::stopAllClientsSig, worker, &ServerWorker::disconnectFromClient);
+    // the socket is set up in the worker thread, pooled workers never come back to this one
+    QTimer::singleShot(0, worker, [worker, socketDescriptor] { worker->start(socketDescriptor); });
     clients.append(worker);
+    workerThreads.insert(worker, threadIdx);
+    connectionIds.insert(worker, ++lastConnectionId);
+    unauthenticated.insert(worker);
+    clientAddresses.insert(worker, address);
+    ++addressConnections[address];
+    if (config.pingInterval > 0) {
+        livenessWheel.schedule(worker, qMax(config.pingInterval / wheelTick, 1));
+    }
+    if (config.loginTimeout > 0) {
+        loginDeadlines.schedule(worker, qMax(config.loginTimeout / wheelTick, 1));
+    }
+    Metrics::set("admission.connections", clients.size());
     qInfo() << "new client connected";
 }
 
@@ -71,16 +188,34 @@ void ServerCore::unicast(const QJsonObject& packet, ServerWorker* const receiver
     }
 }
 
+/* the packet is encoded once and each worker thread gets one call for all of its receivers,
+ * a receiver gone by the time the call runs is skipped */
 void ServerCore::broadcast(const QString& group, const QJsonObject& packet, const ServerWorker* const exclude)
 {
-    for (ServerWorker* const worker : clients) {
+    const auto members = groupMembers.constFind(group);
+    if (members == groupMembers.constEnd()) {
+        return;
+    }
+    QVector<QVector<QPointer<ServerWorker>>> receivers(threads.size());
+    for (ServerWorker* const worker : *members) {
         Q_ASSERT(worker);
         if (worker != exclude) {
-            if (worker->getGroupName() == group) {
-                sendPacket(worker, packet);
-            }
+            receivers[workerThreads.value(worker)].push_back(worker);
         }
     }
+    const QByteArray frame = ServerWorker::encode(packet);
+    for (int threadIdx = 0; threadIdx < receivers.size(); ++threadIdx) {
+        if (receivers.at(threadIdx).isEmpty()) {
+            continue;
+        }
+        QTimer::singleShot(0, threadContexts.at(threadIdx), [frame, threadReceivers = receivers.at(threadIdx)] {
+            for (const QPointer<ServerWorker>& receiver : threadReceivers) {
+                if (receiver) {
+                    receiver->sendFrame(frame);
+                }
+            }
+        });
+    }
 }
 
 bool ServerCore::isUserLoggedIn(const QString& username)
@@ -92,36 +227,66 @@ bool ServerCore::isUserLoggedIn(const QString& username)
 void ServerCore::packetReceived(ServerWorker* sender, const QJsonObject& packet)
 {
     Q_ASSERT(sender);
-    qInfo() << qPrintable("JSON received\n" + QString::fromUtf8(QJsonDocument(packet).toJson(QJsonDocument::Indented)));
+    // the worker already took it as a sign of life
+    if (isEqualPacketType(packet.value(QLatin1String(Packet::Type::TYPE)), Packet::Type::PONG)) {
+        return;
+    }
+    qCDebug(lcPackets) << qPrintable("JSON received\n"
+                                     + QString::fromUtf8(QJsonDocument(packet).toJson(QJsonDocument::Indented)));
 
     const QString& userName = sender->getUserName();
     if (userName.isEmpty()) {
+        // the deadline only drops silent connections, a user filling in the login or register form keeps it
+        if (config.loginTimeout > 0) {
+            loginDeadlines.schedule(sender, qMax(config.loginTimeout / wheelTick, 1));
+        }
         packetFromLoggedOut(sender, packet);
         return;
     }
 
-    const QString& groupName = sender->getGroupName();
-    if (groupName.isEmpty()) {
-        packetFromLoggedIn(sender, packet);
-        return;
-    }
-
-    packetFromConnectedToGroup(sender, packet);
+    packetFromLoggedIn(sender, packet);
 }
 
 void ServerCore::userDisconnected(ServerWorker* const sender, const int threadIdx)
 {
+    if (!connectionIds.contains(sender)) {
+        return;
+    }
     --threadLoadFactor[threadIdx];
     clients.removeAll(sender);
+    workerThreads.remove(sender);
+    connectionIds.remove(sender);
+    fileOffers.remove(sender);
+    userBuckets.remove(sender);
+    livenessWheel.cancel(sender);
+    awaitingPong.remove(sender);
+    loginDeadlines.cancel(sender);
+    unauthenticated.remove(sender);
+    const auto address = addressConnections.find(clientAddresses.take(sender));
+    if (address != addressConnections.end() && --*address <= 0) {
+        addressConnections.erase(address);
+    }
+    Metrics::set("admission.connections", clients.size());
     const QString& userName = sender->getUserName();
     if (!userName.isEmpty()) {
-        QJsonObject packet;
-        packet[Packet::Type::TYPE]     = Packet::Type::USER_LEFT;
-        packet[Packet::Data::USERNAME] = userName;
-        broadcast(sender->getGroupName(), packet, nullptr);
+        for (const QString& groupName : sender->getGroupNames()) {
+            removeFromGroup(sender, groupName);
+        }
         qInfo() << qPrintable(userName + QString(" disconnected"));
     }
-    sender->deleteLater();
+    // the next connection of this thread takes the worker instead of constructing one
+    disconnect(sender, nullptr, this, nullptr);
+    disconnect(this, nullptr, sender, nullptr);
+    if (!draining && idleWorkers.at(threadIdx).size() < maxIdleWorkers) {
+        // start() resets it in its own thread, right before it takes the next connection
+        sender->clearSession();
+        idleWorkers[threadIdx].push_back(sender);
+    } else {
+        sender->deleteLater();
+    }
+    if (draining && clients.isEmpty()) {
+        emit drainedSig();
+    }
 }
 
 void ServerCore::userError(ServerWorker* const sender)
@@ -129,43 +294,137 @@ void ServerCore::userError(ServerWorker* const sender)
     qWarning() << qPrintable(QString("error from <") + sender->getUserName() + QString(">"));
 }
 
+bool ServerCore::isConnection(ServerWorker* const worker, const quint64 connectionId) const
+{
+    return worker != nullptr && connectionIds.value(worker) == connectionId;
+}
+
+bool ServerCore::isAdmitted(const QHostAddress& address) const
+{
+    return config.maxPerAddress <= 0 || addressConnections.value(address) < config.maxPerAddress;
+}
+
+void ServerCore::advanceWheels()
+{
+    checkLiveness();
+    expireLogins();
+}
+
+void ServerCore::expireLogins()
+{
+    for (ServerWorker* const worker : loginDeadlines.advance()) {
+        unauthenticated.remove(worker);
+        Metrics::increment("admission.login_timeouts");
+        QTimer::singleShot(0, worker, [worker] { worker->abortConnection(); });
+    }
+    Metrics::set("admission.unauthenticated", unauthenticated.size());
+}
+
+/* a client silent for a ping interval gets a ping, one still silent when the idle timeout is up is dropped,
+ * half-open connections never say anything and end up here as well */
+void ServerCore::checkLiveness()
+{
+    const int pingTicks = qMax(config.pingInterval / wheelTick, 1);
+    const int pongTicks = qMax((config.idleTimeout - config.pingInterval) / wheelTick, 1);
+    for (ServerWorker* const worker : livenessWheel.advance()) {
+        if (worker->takeActivity()) {
+            awaitingPong.remove(worker);
+            livenessWheel.schedule(worker, pingTicks);
+        } else if (!awaitingPong.contains(worker)) {
+            awaitingPong.insert(worker);
+            QJsonObject pingPacket;
+            pingPacket[Packet::Type::TYPE] = Packet::Type::PING;
+            sendPacket(worker, pingPacket);
+            Metrics::increment("liveness.pings");
+            livenessWheel.schedule(worker, pongTicks);
+        } else {
+            // the disconnect that follows cleans up like for any other client
+            awaitingPong.remove(worker);
+            Metrics::increment("liveness.reaped");
+            qInfo() << qPrintable(QString("<%1> timed out").arg(worker->getUserName()));
+            QTimer::singleShot(0, worker, [worker] { worker->abortConnection(); });
+        }
+    }
+    Metrics::set("liveness.clients", livenessWheel.size());
+    Metrics::set("liveness.awaiting_pong", awaitingPong.size());
+}
+
 void ServerCore::stopServer()
 {
     emit stopAllClientsSig();
     close();
 }
 
+/* stop accepting and send clients to the next process, spread over time to avoid a reconnect storm */
+void ServerCore::drain()
+{
+    if (draining) {
+        return;
+    }
+    draining = true;
+    close();
+    qInfo() << qPrintable(QString("draining %1 clients").arg(clients.size()));
+
+    static std::mt19937 randomEngine{std::random_device{}()};
+    std::uniform_int_distribution<int> retryAfter(0, config.drainSpread);
+    for (ServerWorker* const worker : clients) {
+        QJsonObject packet;
+        packet[Packet::Type::TYPE]        = Packet::Type::DRAIN;
+        packet[Packet::Data::RETRY_AFTER] = retryAfter(randomEngine);
+        const QString userName            = worker->getUserName();
+        if (!userName.isEmpty()) {
+            packet[Packet::Data::TOKEN] = sessions.issue(userName);
+        }
+        sendPacket(worker, packet);
+    }
+    sessions.save();
+
+    if (clients.isEmpty()) {
+        emit drainedSig();
+        return;
+    }
+    QTimer::singleShot(config.drainGrace, this, [this] { emit stopAllClientsSig(); });
+}
+
 bool ServerCore::isEqualPacketType(const QJsonValue& jsonType, const char* const strType)
 {
     return jsonType.toString().compare(QLatin1String(strType), Qt::CaseInsensitive) == 0;
 }
 
-QJsonArray ServerCore::getUsernames(ServerWorker* const exclude) const
+QJsonArray ServerCore::getUsernames(const QString& groupName, ServerWorker* const exclude) const
 {
     QJsonArray usernames;
-    for (ServerWorker* worker : clients) {
+    for (ServerWorker* worker : groupMembers.value(groupName)) {
         Q_ASSERT(worker);
         if (worker != exclude) {
-            if (worker->getGroupName() == exclude->getGroupName()) {
-                QString username = worker->getUserName();
-                if (!username.isEmpty()) {
-                    usernames.push_back(qMove(username));
-                }
+            QString username = worker->getUserName();
+            if (!username.isEmpty()) {
+                usernames.push_back(qMove(username));
             }
         }
     }
+    if (cluster) {
+        for (const QString& username : cluster->remoteMembers(groupName)) {
+            usernames.push_back(username);
+        }
+    }
     return usernames;
 }
 
-QJsonArray ServerCore::getMessages(const QString& groupName)
+QJsonArray ServerCore::messagesToJson(const QList<Message>& dbMessages)
 {
-    QList<Message> dbMessages = db::fetchMessages(groupName);
     QJsonArray messages;
     for (const auto& message : dbMessages) {
         QJsonObject leafObject;
-        leafObject[Packet::Data::SENDER] = message.getSender();
-        leafObject[Packet::Data::TEXT]   = message.getMessage();
-        leafObject[Packet::Data::TIME]   = message.getTime();
+        leafObject[Packet::Data::ID]        = static_cast<double>(message.getId());
+        leafObject[Packet::Data::SENDER]    = message.getSender();
+        leafObject[Packet::Data::TEXT]      = message.getMessage().toString();
+        leafObject[Packet::Data::TIME]      = message.getTime();
+        leafObject[Packet::Data::TIMESTAMP] = static_cast<double>(message.getTimestamp());
+        if (!message.getAttachment().isEmpty()) {
+            leafObject[Packet::Data::FILE_HASH] = message.getAttachment().toString();
+            leafObject[Packet::Data::FILE_SIZE] = static_cast<double>(message.getAttachmentSize());
+        }
         messages.push_back(leafObject);
     }
     return messages;
@@ -217,11 +476,42 @@ void ServerCore::registerUser(ServerWorker* const sender, const QJsonObject& pac
     if (password.isEmpty()) {
         return;
     }
-    db::addUser(userName, password);
+    if (config.hashCredentials) {
+        QPointer<ServerWorker> guard(sender);
+        const quint64 connectionId = connectionIds.value(sender);
+        const bool queued =
+            authPool->hash(password, this, [this, guard, connectionId, userName](const QString& hashed) {
+                // a pooled worker may carry another connection by now
+                completeRegister(isConnection(guard, connectionId) ? guard : nullptr, userName, hashed);
+            });
+        if (!queued) {
+            sendServerBusy(sender, Packet::Type::REGISTER);
+        }
+    } else {
+        completeRegister(sender, userName, password);
+    }
     // for security reason clear sensitive info
     passwordVal = QJsonValue();
     password.clear();
     //
+}
+
+void ServerCore::completeRegister(ServerWorker* const sender, const QString& userName, const QString& storedPassword)
+{
+    // the name could be taken while the password was hashed
+    if (!db::addUser(userName, storedPassword)) {
+        if (sender != nullptr && clients.contains(sender)) {
+            QJsonObject errorPacket;
+            errorPacket[Packet::Type::TYPE]    = Packet::Type::REGISTER;
+            errorPacket[Packet::Data::SUCCESS] = false;
+            errorPacket[Packet::Data::REASON]  = "user with such name already exist";
+            sendPacket(sender, errorPacket);
+        }
+        return;
+    }
+    if (sender == nullptr || !clients.contains(sender)) {
+        return;
+    }
 
     // register success
     QJsonObject successPacket;
@@ -230,6 +520,15 @@ void ServerCore::registerUser(ServerWorker* const sender, const QJsonObject& pac
     sendPacket(sender, successPacket);
 }
 
+void ServerCore::sendServerBusy(ServerWorker* const destination, const char* const packetType)
+{
+    QJsonObject errorPacket;
+    errorPacket[Packet::Type::TYPE]    = packetType;
+    errorPacket[Packet::Data::SUCCESS] = false;
+    errorPacket[Packet::Data::REASON]  = "server is busy, try again later";
+    sendPacket(destination, errorPacket);
+}
+
 void ServerCore::loginUser(ServerWorker* const sender, const QJsonObject& packet)
 {
     // parse username
@@ -242,8 +541,9 @@ void ServerCore::loginUser(ServerWorker* const sender, const QJsonObject& packet
         return;
     }
 
-    // check user
-    if (!db::isUserExist(userName)) {
+    // check user, passwords are never empty so an empty one means there is no such user
+    const QString storedPassword = db::fetchUserPassword(userName);
+    if (storedPassword.isEmpty()) {
         QJsonObject errorPacket;
         errorPacket[Packet::Type::TYPE]    = Packet::Type::LOGIN;
         errorPacket[Packet::Data::SUCCESS] = false;
@@ -252,6 +552,13 @@ void ServerCore::loginUser(ServerWorker* const sender, const QJsonObject& packet
         return;
     }
 
+    // resume a session handed over by the previous server process
+    const QJsonValue tokenVal = packet.value(QLatin1String(Packet::Data::TOKEN));
+    if (tokenVal.isString()) {
+        completeLogin(sender, userName, sessions.redeem(tokenVal.toString()) == userName);
+        return;
+    }
+
     // parse password
     QJsonValue passwordVal = packet.value(QLatin1String(Packet::Data::PASSWORD));
     if (passwordVal.isNull() || !passwordVal.isString()) {
@@ -263,7 +570,39 @@ void ServerCore::loginUser(ServerWorker* const sender, const QJsonObject& packet
     }
 
     // check password
-    if (password != db::fetchUserPassword(userName)) {
+    if (credentials::isHashed(storedPassword)) {
+        QPointer<ServerWorker> guard(sender);
+        const quint64 connectionId = connectionIds.value(sender);
+        const bool queued =
+            authPool->verify(password, storedPassword, this, [this, guard, connectionId, userName](bool valid) {
+                if (isConnection(guard, connectionId)) {
+                    completeLogin(guard, userName, valid);
+                }
+            });
+        if (!queued) {
+            sendServerBusy(sender, Packet::Type::LOGIN);
+        }
+    } else {
+        const bool valid = password == storedPassword;
+        if (valid && config.hashCredentials) {
+            // upgrade legacy plaintext credentials in background
+            authPool->hash(password, this,
+                           [userName](const QString& hashed) { db::updateUserPassword(userName, hashed); });
+        }
+        completeLogin(sender, userName, valid);
+    }
+    // for security reason clear sensitive info
+    passwordVal = QJsonValue();
+    password.clear();
+    //
+}
+
+void ServerCore::completeLogin(ServerWorker* const sender, const QString& userName, const bool validPassword)
+{
+    if (!clients.contains(sender)) {
+        return;
+    }
+    if (!validPassword) {
         QJsonObject errorPacket;
         errorPacket[Packet::Type::TYPE]    = Packet::Type::LOGIN;
         errorPacket[Packet::Data::SUCCESS] = false;
@@ -271,10 +610,6 @@ void ServerCore::loginUser(ServerWorker* const sender, const QJsonObject& packet
         sendPacket(sender, errorPacket);
         return;
     }
-    // for security reason clear sensitive info
-    passwordVal = QJsonValue();
-    password.clear();
-    //
 
     if (isUserLoggedIn(userName)) {
         QJsonObject errorPacket;
@@ -287,9 +622,12 @@ void ServerCore::loginUser(ServerWorker* const sender, const QJsonObject& packet
 
     // login success
     sender->setUserName(userName);
+    unauthenticated.remove(sender);
+    loginDeadlines.cancel(sender);
     QJsonObject successPacket;
     successPacket[Packet::Type::TYPE]    = Packet::Type::LOGIN;
     successPacket[Packet::Data::SUCCESS] = true;
+    successPacket[Packet::Data::EPOCH]   = historyEpoch;
     sendPacket(sender, successPacket);
 }
 
@@ -315,11 +653,15 @@ void ServerCore::connectGroup(ServerWorker* sender, const QJsonObject& packet)
         return;
     }
 
-    if (!db::isGroupExist(groupName)) {
+    // group, password and missed messages in one round trip
+    const qint64 lastId      = static_cast<qint64>(packet.value(QLatin1String(Packet::Data::LAST_ID)).toDouble(0));
+    const db::GroupJoin group = db::fetchGroupJoin(groupName, qMax<qint64>(lastId, 0));
+    if (!group.exists) {
         QJsonObject errorPacket;
-        errorPacket[Packet::Type::TYPE]    = Packet::Type::CONNECT_GROUP;
-        errorPacket[Packet::Data::SUCCESS] = false;
-        errorPacket[Packet::Data::REASON]  = "group with such name does not exist";
+        errorPacket[Packet::Type::TYPE]       = Packet::Type::CONNECT_GROUP;
+        errorPacket[Packet::Data::GROUP_NAME] = groupName;
+        errorPacket[Packet::Data::SUCCESS]    = false;
+        errorPacket[Packet::Data::REASON]     = "group with such name does not exist";
         sendPacket(sender, errorPacket);
         return;
     }
@@ -335,11 +677,12 @@ void ServerCore::connectGroup(ServerWorker* sender, const QJsonObject& packet)
     }
 
     // check password
-    if (password != db::fetchGroupPassword(groupName)) {
+    if (password != group.password) {
         QJsonObject errorPacket;
-        errorPacket[Packet::Type::TYPE]    = Packet::Type::CONNECT_GROUP;
-        errorPacket[Packet::Data::SUCCESS] = false;
-        errorPacket[Packet::Data::REASON]  = "invalid password";
+        errorPacket[Packet::Type::TYPE]       = Packet::Type::CONNECT_GROUP;
+        errorPacket[Packet::Data::GROUP_NAME] = groupName;
+        errorPacket[Packet::Data::SUCCESS]    = false;
+        errorPacket[Packet::Data::REASON]     = "invalid password";
         sendPacket(sender, errorPacket);
         return;
     }
@@ -348,25 +691,108 @@ void ServerCore::connectGroup(ServerWorker* sender, const QJsonObject& packet)
     password.clear();
     //
 
-    // connect group success
-    sender->setGroupName(groupName);
+    // connect group success, a connection may follow many groups
+    const bool alreadyMember = sender->isInGroup(groupName);
+    sender->joinGroup(groupName);
+    QSet<ServerWorker*>& members = groupMembers[groupName];
+    if (members.isEmpty() && cluster) {
+        cluster->subscribe(groupName);
+    }
+    members.insert(sender);
     QJsonObject successPacket;
-    successPacket[Packet::Type::TYPE]    = Packet::Type::CONNECT_GROUP;
-    successPacket[Packet::Data::SUCCESS] = true;
+    successPacket[Packet::Type::TYPE]       = Packet::Type::CONNECT_GROUP;
+    successPacket[Packet::Data::GROUP_NAME] = groupName;
+    successPacket[Packet::Data::SUCCESS]    = true;
     sendPacket(sender, successPacket);
 
-    // send all messages to user
+    // send messages the user has not cached yet
     QJsonObject unicastPacket;
-    unicastPacket[Packet::Type::TYPE]      = Packet::Type::INFORM_JOINER;
-    unicastPacket[Packet::Data::USERNAMES] = getUsernames(sender);
-    unicastPacket[Packet::Data::MESSAGES]  = getMessages(sender->getGroupName());
+    unicastPacket[Packet::Type::TYPE]       = Packet::Type::INFORM_JOINER;
+    unicastPacket[Packet::Data::GROUP_NAME] = groupName;
+    unicastPacket[Packet::Data::USERNAMES]  = getUsernames(groupName, sender);
+    unicastPacket[Packet::Data::MESSAGES]   = messagesToJson(group.messages);
     this->unicast(unicastPacket, sender);
 
-    // user joined broadcast
-    QJsonObject connectedBroadcastPacket;
-    connectedBroadcastPacket[Packet::Type::TYPE]     = Packet::Type::USER_JOINED;
-    connectedBroadcastPacket[Packet::Data::USERNAME] = userName;
-    this->broadcast(sender->getGroupName(), connectedBroadcastPacket, sender);
+    if (!alreadyMember) {
+        presence->joined(groupName, userName);
+    }
+}
+
+void ServerCore::leaveGroup(ServerWorker* const sender, const QJsonObject& packet)
+{
+    // parse group name
+    const QJsonValue groupNameVal = packet.value(QLatin1String(Packet::Data::GROUP_NAME));
+    if (groupNameVal.isNull() || !groupNameVal.isString()) {
+        return;
+    }
+    const QString groupName = groupNameVal.toString().simplified();
+    if (groupName.isEmpty() || !sender->isInGroup(groupName)) {
+        return;
+    }
+
+    removeFromGroup(sender, groupName);
+
+    QJsonObject successPacket;
+    successPacket[Packet::Type::TYPE]       = Packet::Type::LEAVE_GROUP;
+    successPacket[Packet::Data::GROUP_NAME] = groupName;
+    successPacket[Packet::Data::SUCCESS]    = true;
+    sendPacket(sender, successPacket);
+}
+
+void ServerCore::removeFromGroup(ServerWorker* const member, const QString& groupName)
+{
+    member->leaveGroup(groupName);
+    auto members = groupMembers.find(groupName);
+    if (members == groupMembers.end()) {
+        return;
+    }
+    members->remove(member);
+    // other nodes still learn about the leave from the next presence delta
+    presence->left(groupName, member->getUserName());
+    if (members->isEmpty()) {
+        groupMembers.erase(members);
+        groupBuckets.remove(groupName);
+        if (cluster) {
+            cluster->unsubscribe(groupName);
+        }
+    }
+}
+
+void ServerCore::publish(const QString& groupName, const QJsonObject& packet)
+{
+    if (cluster) {
+        cluster->publish(groupName, packet);
+    }
+}
+
+/* a node just subscribed to the group, it gets our members as one presence delta */
+void ServerCore::syncGroup(const QString& groupName)
+{
+    QStringList joined;
+    for (ServerWorker* const worker : groupMembers.value(groupName)) {
+        joined.push_back(worker->getUserName());
+    }
+    if (joined.isEmpty()) {
+        return;
+    }
+    QJsonObject packet;
+    packet[Packet::Type::TYPE]       = Packet::Type::PRESENCE;
+    packet[Packet::Data::GROUP_NAME] = groupName;
+    packet[Packet::Data::JOINED]     = QJsonArray::fromStringList(joined);
+    packet[Packet::Data::LEFT]       = QJsonArray();
+    publish(groupName, packet);
+}
+
+/* one packet per group and tick instead of one per joined or left user */
+void ServerCore::sendPresence(const QString& groupName, const QStringList& joined, const QStringList& left)
+{
+    QJsonObject packet;
+    packet[Packet::Type::TYPE]       = Packet::Type::PRESENCE;
+    packet[Packet::Data::GROUP_NAME] = groupName;
+    packet[Packet::Data::JOINED]     = QJsonArray::fromStringList(joined);
+    packet[Packet::Data::LEFT]       = QJsonArray::fromStringList(left);
+    broadcast(groupName, packet, nullptr);
+    publish(groupName, packet);
 }
 
 void ServerCore::createGroup(ServerWorker* sender, const QJsonObject& packet)
@@ -427,30 +853,30 @@ void ServerCore::packetFromLoggedIn(ServerWorker* sender, const QJsonObject& pac
         connectGroup(sender, packet);
     } else if (isEqualPacketType(typeVal, Packet::Type::CREATE_GROUP)) {
         createGroup(sender, packet);
+    } else if (isEqualPacketType(typeVal, Packet::Type::LEAVE_GROUP)) {
+        leaveGroup(sender, packet);
+    } else if (isEqualPacketType(typeVal, Packet::Type::MESSAGE)) {
+        packetFromConnectedToGroup(sender, packet);
+    } else if (isEqualPacketType(typeVal, Packet::Type::SEARCH)) {
+        searchGroup(sender, packet);
+    } else if (isEqualPacketType(typeVal, Packet::Type::HISTORY)) {
+        sendHistory(sender, packet);
+    } else if (isEqualPacketType(typeVal, Packet::Type::FILE_OFFER)) {
+        offerFile(sender, packet);
+    } else if (isEqualPacketType(typeVal, Packet::Type::FILE_DOWNLOAD)) {
+        downloadFile(sender, packet);
     }
 }
 
 void ServerCore::packetFromConnectedToGroup(ServerWorker* const sender, const QJsonObject& packet)
 {
     Q_ASSERT(sender);
-    const QJsonValue typeVal = packet.value(QLatin1String(Packet::Type::TYPE));
-    if (typeVal.isNull() || !typeVal.isString()) {
-        return;
-    }
-
-    if (isEqualPacketType(typeVal, Packet::Type::CONNECT_GROUP) ||
-        isEqualPacketType(typeVal, Packet::Type::CREATE_GROUP)) {
-        packetFromLoggedIn(sender, packet);
-    } else if (!isEqualPacketType(typeVal, Packet::Type::MESSAGE)) {
-        return;
-    }
-
     const QJsonValue groupVal = packet.value(QLatin1String(Packet::Data::GROUP_NAME));
     if (groupVal.isNull() || !groupVal.isString()) {
         return;
     }
     const QString groupName = groupVal.toString();
-    if (groupName.isEmpty()) {
+    if (groupName.isEmpty() || !sender->isInGroup(groupName)) {
         return;
     }
 
@@ -481,12 +907,313 @@ void ServerCore::packetFromConnectedToGroup(ServerWorker* const sender, const QJ
         return;
     }
 
+    if (const qint64 retryAfter = throttle(sender, groupName); retryAfter > 0) {
+        sendSlowDown(sender, groupName, retryAfter);
+        return;
+    }
+    postMessage({groupName, sender->getUserName(), text, time, 0, nextTimestamp()});
+}
+
+/* returns 0 when the sender may post to the group now, else the ms to wait,
+ * the sender's token is spent even when the group is the one over its limit */
+qint64 ServerCore::throttle(ServerWorker* const sender, const QString& groupName)
+{
+    const qint64 now = throttleClock.elapsed();
+    auto userBucket  = userBuckets.find(sender);
+    if (userBucket == userBuckets.end()) {
+        userBucket = userBuckets.insert(sender, TokenBucket(config.userMessageRate, config.userMessageBurst));
+    }
+    if (const qint64 retryAfter = userBucket->take(now); retryAfter > 0) {
+        Metrics::increment("throttle.user");
+        return retryAfter;
+    }
+    auto groupBucket = groupBuckets.find(groupName);
+    if (groupBucket == groupBuckets.end()) {
+        groupBucket = groupBuckets.insert(groupName, TokenBucket(config.groupMessageRate, config.groupMessageBurst));
+    }
+    if (const qint64 retryAfter = groupBucket->take(now); retryAfter > 0) {
+        Metrics::increment("throttle.group");
+        return retryAfter;
+    }
+    return 0;
+}
+
+void ServerCore::sendSlowDown(ServerWorker* const destination, const QString& groupName, const qint64 retryAfter)
+{
+    QJsonObject slowDownPacket;
+    slowDownPacket[Packet::Type::TYPE]        = Packet::Type::SLOW_DOWN;
+    slowDownPacket[Packet::Data::GROUP_NAME]  = groupName;
+    slowDownPacket[Packet::Data::RETRY_AFTER] = static_cast<double>(retryAfter);
+    sendPacket(destination, slowDownPacket);
+}
+
+void ServerCore::postMessage(const Message& message)
+{
+    const qint64 id = db::addMessage(message);
+    if (id > 0) {
+        searchIndex->add(message.getGroupName(), id, message.getMessage().toString());
+    }
+
+    // the sender gets the echo too, clients cache messages by their id
     QJsonObject broadcastPacket;
-    broadcastPacket[Packet::Type::TYPE]   = Packet::Type::MESSAGE;
-    broadcastPacket[Packet::Data::SENDER] = sender->getUserName();
-    broadcastPacket[Packet::Data::TEXT]   = text;
-    broadcastPacket[Packet::Data::TIME]   = time;
-    broadcast(sender->getGroupName(), broadcastPacket, sender);
+    broadcastPacket[Packet::Type::TYPE]       = Packet::Type::MESSAGE;
+    broadcastPacket[Packet::Data::ID]         = static_cast<double>(id);
+    broadcastPacket[Packet::Data::GROUP_NAME] = message.getGroupName();
+    broadcastPacket[Packet::Data::SENDER]     = message.getSender();
+    broadcastPacket[Packet::Data::TEXT]       = message.getMessage().toString();
+    broadcastPacket[Packet::Data::TIME]       = message.getTime();
+    broadcastPacket[Packet::Data::TIMESTAMP]  = static_cast<double>(message.getTimestamp());
+    if (!message.getAttachment().isEmpty()) {
+        broadcastPacket[Packet::Data::FILE_HASH] = message.getAttachment().toString();
+        broadcastPacket[Packet::Data::FILE_SIZE] = static_cast<double>(message.getAttachmentSize());
+    }
+    broadcast(message.getGroupName(), broadcastPacket, nullptr);
+    publish(message.getGroupName(), broadcastPacket);
+}
+
+void ServerCore::searchGroup(ServerWorker* const sender, const QJsonObject& packet)
+{
+    Q_ASSERT(sender);
+    const QJsonValue groupVal = packet.value(QLatin1String(Packet::Data::GROUP_NAME));
+    if (groupVal.isNull() || !groupVal.isString()) {
+        return;
+    }
+    const QString groupName = groupVal.toString().simplified();
+    if (groupName.isEmpty() || !sender->isInGroup(groupName)) {
+        return;
+    }
+
+    const QJsonValue queryVal = packet.value(QLatin1String(Packet::Data::QUERY));
+    if (queryVal.isNull() || !queryVal.isString()) {
+        return;
+    }
+    const QString query = queryVal.toString().simplified();
+    if (query.isEmpty() || query.size() > maxQuerySize) {
+        return;
+    }
+
+    // pages go from the newest hit backwards, a page continues below the oldest id of the previous one
+    const qint64 beforeId = static_cast<qint64>(packet.value(QLatin1String(Packet::Data::BEFORE_ID)).toDouble(0));
+    const SearchIndex::Page page = searchIndex->search(groupName, query, qMax<qint64>(beforeId, 0), searchPageSize);
+    QList<Message> hits = db::fetchMessagesByIds(groupName, page.ids);
+    std::reverse(hits.begin(), hits.end());
+
+    QJsonObject resultPacket;
+    resultPacket[Packet::Type::TYPE]       = Packet::Type::SEARCH;
+    resultPacket[Packet::Data::GROUP_NAME] = groupName;
+    resultPacket[Packet::Data::QUERY]      = query;
+    resultPacket[Packet::Data::SUCCESS]    = true;
+    resultPacket[Packet::Data::MESSAGES]   = messagesToJson(hits);
+    resultPacket[Packet::Data::HAS_MORE]   = page.hasMore;
+    sendPacket(sender, resultPacket);
+}
+
+void ServerCore::indexRemoteMessage(const QJsonObject& packet)
+{
+    // messages of other nodes are already stored, only the local index lags behind
+    if (!isEqualPacketType(packet.value(QLatin1String(Packet::Type::TYPE)), Packet::Type::MESSAGE)) {
+        return;
+    }
+    const QString groupName = packet.value(QLatin1String(Packet::Data::GROUP_NAME)).toString();
+    const qint64 id         = static_cast<qint64>(packet.value(QLatin1String(Packet::Data::ID)).toDouble(0));
+    if (!groupName.isEmpty() && id > 0) {
+        searchIndex->add(groupName, id, packet.value(QLatin1String(Packet::Data::TEXT)).toString());
+    }
+}
+
+void ServerCore::sendHistory(ServerWorker* const sender, const QJsonObject& packet)
+{
+    Q_ASSERT(sender);
+    const QJsonValue groupVal = packet.value(QLatin1String(Packet::Data::GROUP_NAME));
+    if (groupVal.isNull() || !groupVal.isString()) {
+        return;
+    }
+    const QString groupName = groupVal.toString().simplified();
+    if (groupName.isEmpty() || !sender->isInGroup(groupName)) {
+        return;
+    }
+
+    // an open end runs up to now, the next page starts at the timestamp and id of the last message
+    const qint64 from    = static_cast<qint64>(packet.value(QLatin1String(Packet::Data::FROM)).toDouble(0));
+    const qint64 to      = static_cast<qint64>(packet.value(QLatin1String(Packet::Data::TO)).toDouble(0));
+    const qint64 afterId = static_cast<qint64>(packet.value(QLatin1String(Packet::Data::LAST_ID)).toDouble(0));
+    QList<Message> messages =
+        db::fetchMessagesInRange(groupName, qMax<qint64>(from, 0), to > 0 ? to : std::numeric_limits<qint64>::max(),
+                                 qMax<qint64>(afterId, 0), historyPageSize + 1);
+    const bool hasMore = messages.size() > historyPageSize;
+    if (hasMore) {
+        messages.removeLast();
+    }
+
+    QJsonObject historyPacket;
+    historyPacket[Packet::Type::TYPE]       = Packet::Type::HISTORY;
+    historyPacket[Packet::Data::GROUP_NAME] = groupName;
+    historyPacket[Packet::Data::FROM]       = static_cast<double>(qMax<qint64>(from, 0));
+    historyPacket[Packet::Data::TO]         = static_cast<double>(qMax<qint64>(to, 0));
+    historyPacket[Packet::Data::MESSAGES]   = messagesToJson(messages);
+    historyPacket[Packet::Data::HAS_MORE]   = hasMore;
+    sendPacket(sender, historyPacket);
+}
+
+/* the group only gets a reference to the file, its data comes in chunks the worker writes to disk */
+void ServerCore::offerFile(ServerWorker* const sender, const QJsonObject& packet)
+{
+    Q_ASSERT(sender);
+    const QJsonValue groupVal = packet.value(QLatin1String(Packet::Data::GROUP_NAME));
+    if (groupVal.isNull() || !groupVal.isString()) {
+        return;
+    }
+    const QString groupName = groupVal.toString().simplified();
+    if (groupName.isEmpty() || !sender->isInGroup(groupName)) {
+        return;
+    }
+
+    const QJsonValue fileNameVal = packet.value(QLatin1String(Packet::Data::FILE_NAME));
+    if (fileNameVal.isNull() || !fileNameVal.isString()) {
+        return;
+    }
+    // paths of the sender mean nothing to the others
+    const QString fileName = QFileInfo(fileNameVal.toString()).fileName().simplified();
+    if (fileName.isEmpty() || fileName.size() > maxFileNameSize) {
+        return;
+    }
+
+    const QJsonValue hashVal = packet.value(QLatin1String(Packet::Data::FILE_HASH));
+    if (hashVal.isNull() || !hashVal.isString()) {
+        return;
+    }
+    const QString hash = hashVal.toString().toLower();
+    if (!FileStore::isValidHash(hash)) {
+        return;
+    }
+
+    const qint64 size = static_cast<qint64>(packet.value(QLatin1String(Packet::Data::FILE_SIZE)).toDouble(0));
+    if (!files.isEnabled()) {
+        sendFileOfferError(sender, groupName, hash, fileName, "file transfer is disabled");
+        return;
+    }
+    if (size <= 0 || size > files.getMaxFileSize()) {
+        sendFileOfferError(sender, groupName, hash, fileName, "file size is not accepted");
+        return;
+    }
+    QHash<QString, FileOffer>& offers = fileOffers[sender];
+    if (offers.contains(hash) || offers.size() >= maxUploads) {
+        sendFileOfferError(sender, groupName, hash, fileName, "too many uploads at once");
+        return;
+    }
+    // the file becomes a message of the group, it counts against the same limits before any data is sent
+    if (throttle(sender, groupName) > 0) {
+        sendFileOfferError(sender, groupName, hash, fileName, "sending too fast, try again later");
+        return;
+    }
+
+    QJsonObject offerPacket;
+    offerPacket[Packet::Type::TYPE]      = Packet::Type::FILE_OFFER;
+    offerPacket[Packet::Data::FILE_HASH] = hash;
+    offerPacket[Packet::Data::FILE_NAME] = fileName;
+    offerPacket[Packet::Data::SUCCESS]   = true;
+    // stored content is only referenced again, the client has nothing left to send
+    if (files.contains(hash)) {
+        offerPacket[Packet::Data::OFFSET] = static_cast<double>(size);
+        sendPacket(sender, offerPacket);
+        postAttachment(sender, groupName, fileName, hash, QFileInfo(files.filePath(hash)).size());
+        return;
+    }
+
+    offers.insert(hash, {groupName, fileName, size});
+    const QByteArray rawHash = QByteArray::fromHex(hash.toLatin1());
+    const QString partPath   = files.partPath(hash, reinterpret_cast<quintptr>(sender));
+    const QString target     = files.filePath(hash);
+    // queued before the answer, so the worker expects chunks by the time the client sends them
+    QTimer::singleShot(0, sender, [sender, rawHash, size, partPath, target] {
+        sender->receiveFile(rawHash, size, partPath, target);
+    });
+    offerPacket[Packet::Data::OFFSET] = 0;
+    sendPacket(sender, offerPacket);
+}
+
+void ServerCore::fileReceived(ServerWorker* const sender, const QByteArray& hash, const bool valid)
+{
+    const auto offers = fileOffers.find(sender);
+    if (offers == fileOffers.end()) {
+        return;
+    }
+    const QString hexHash = QString::fromLatin1(hash.toHex());
+    const FileOffer offer = offers->take(hexHash);
+    if (offer.groupName.isEmpty()) {
+        return;
+    }
+    if (!valid) {
+        sendFileOfferError(sender, offer.groupName, hexHash, offer.fileName, "upload failed");
+        return;
+    }
+    // the file stays stored for whoever sends it next
+    if (sender->isInGroup(offer.groupName)) {
+        postAttachment(sender, offer.groupName, offer.fileName, hexHash, offer.size);
+    }
+}
+
+void ServerCore::sendFileOfferError(ServerWorker* const destination, const QString& groupName, const QString& hash,
+                                    const QString& fileName, const QString& reason)
+{
+    QJsonObject errorPacket;
+    errorPacket[Packet::Type::TYPE]       = Packet::Type::FILE_OFFER;
+    errorPacket[Packet::Data::GROUP_NAME] = groupName;
+    errorPacket[Packet::Data::FILE_HASH]  = hash;
+    errorPacket[Packet::Data::FILE_NAME]  = fileName;
+    errorPacket[Packet::Data::SUCCESS]    = false;
+    errorPacket[Packet::Data::REASON]     = reason;
+    sendPacket(destination, errorPacket);
+}
+
+void ServerCore::postAttachment(ServerWorker* const sender, const QString& groupName, const QString& fileName,
+                                const QString& hash, const qint64 size)
+{
+    const qint64 timestamp = nextTimestamp();
+    Message message(groupName, sender->getUserName(), fileName,
+                    QDateTime::fromMSecsSinceEpoch(timestamp).toString("hh:mm"), 0, timestamp);
+    message.setAttachment(hash, size);
+    postMessage(message);
+}
+
+/* members of a group may fetch any file by its hash, which is only learned from a message */
+void ServerCore::downloadFile(ServerWorker* const sender, const QJsonObject& packet)
+{
+    Q_ASSERT(sender);
+    const QJsonValue groupVal = packet.value(QLatin1String(Packet::Data::GROUP_NAME));
+    if (groupVal.isNull() || !groupVal.isString()) {
+        return;
+    }
+    const QString groupName = groupVal.toString().simplified();
+    if (groupName.isEmpty() || !sender->isInGroup(groupName)) {
+        return;
+    }
+
+    const QJsonValue hashVal = packet.value(QLatin1String(Packet::Data::FILE_HASH));
+    if (hashVal.isNull() || !hashVal.isString()) {
+        return;
+    }
+    const QString hash = hashVal.toString().toLower();
+    if (!FileStore::isValidHash(hash)) {
+        return;
+    }
+    if (!files.isEnabled() || !files.contains(hash)) {
+        QJsonObject errorPacket;
+        errorPacket[Packet::Type::TYPE]      = Packet::Type::FILE_DOWNLOAD;
+        errorPacket[Packet::Data::FILE_HASH] = hash;
+        errorPacket[Packet::Data::SUCCESS]   = false;
+        errorPacket[Packet::Data::REASON]    = "file is not available";
+        sendPacket(sender, errorPacket);
+        return;
+    }
+
+    const QByteArray rawHash = QByteArray::fromHex(hash.toLatin1());
+    const QString path       = files.filePath(hash);
+    QTimer::singleShot(0, sender, [sender, rawHash, path] { sender->sendFile(rawHash, path); });
+}
 
-    db::addMessage({groupName, senderName, text, time});
+qint64 ServerCore::nextTimestamp()
+{
+    lastTimestamp = qMax(QDateTime::currentMSecsSinceEpoch(), lastTimestamp);
+    return lastTimestamp;
 }
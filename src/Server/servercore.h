@@ -5,49 +5,133 @@
 #include <QVector>
 #include <QThread>
 #include <QJsonObject>
+#include <QHash>
+#include <QSet>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QHostAddress>
 #include "serverworker.h"
+#include "serverconfig.h"
+#include "authpool.h"
+#include "presencebatcher.h"
+#include "clusternode.h"
+#include "sessionstore.h"
+#include "messagelog.h"
+#include "searchindex.h"
+#include "filestore.h"
+#include "tokenbucket.h"
+#include "timerwheel.h"
 
 class ServerCore : public QTcpServer
 {
     Q_OBJECT
     Q_DISABLE_COPY(ServerCore)
 public:
-    explicit ServerCore(QObject* parent = nullptr);
+    explicit ServerCore(const ServerConfig& config, QObject* parent = nullptr);
     ~ServerCore() override;
 
 protected:
     void incomingConnection(qintptr socketDescriptor) override;
 
 private:
+    const ServerConfig config;
     const int idealThreadCount;
+    AuthPool* authPool;
+    PresenceBatcher* presence;
+    ClusterNode* cluster; // nullptr when running standalone
+    SessionStore sessions;
+    MessageLog* messageLog; // nullptr when messages live in the database
+    SearchIndex* searchIndex;
+    FileStore files;
+    bool draining;
+    qint64 lastTimestamp; // stamps never go back, even when the clock does
+    QString historyEpoch; // changes whenever message ids start over, clients drop their caches then
     QVector<QThread*> threads;
+    QVector<QObject*> threadContexts; // broadcasts run in the worker threads through these
+    QHash<ServerWorker*, int> workerThreads;
+    QVector<QVector<ServerWorker*>> idleWorkers; // per thread, reset and waiting for a connection
+    QHash<ServerWorker*, quint64> connectionIds;
+    quint64 lastConnectionId = 0;
     QVector<int> threadLoadFactor;
     QVector<ServerWorker*> clients;
+    QHash<QString, QSet<ServerWorker*>> groupMembers;
+    struct FileOffer {
+        QString groupName;
+        QString fileName;
+        qint64 size = 0;
+    };
+    QHash<ServerWorker*, QHash<QString, FileOffer>> fileOffers; // uploads in progress by hash
+    QElapsedTimer throttleClock;
+    QHash<ServerWorker*, TokenBucket> userBuckets;
+    QHash<QString, TokenBucket> groupBuckets;
+    QTimer* wheelTimer;
+    TimerWheel<ServerWorker*> livenessWheel; // next liveness check of every client
+    QSet<ServerWorker*> awaitingPong;
+    TimerWheel<ServerWorker*> loginDeadlines;
+    QSet<ServerWorker*> unauthenticated;
+    QHash<ServerWorker*, QHostAddress> clientAddresses;
+    QHash<QHostAddress, int> addressConnections;
+    static constexpr int searchPageSize  = 20;
+    static constexpr int maxQuerySize    = 256;
+    static constexpr int historyPageSize = 100;
+    static constexpr int maxFileNameSize = 255;
+    static constexpr int maxUploads      = 4;
+    static constexpr int wheelTick       = 1000; // ms
+    static constexpr int maxIdleWorkers  = 64;
 private slots:
     void unicast(const QJsonObject& packet, ServerWorker* receiver);
     void broadcast(const QString& group, const QJsonObject& packet, const ServerWorker* exclude);
     void packetReceived(ServerWorker* sender, const QJsonObject& packet);
     void userDisconnected(ServerWorker* sender, int threadIdx);
     static void userError(ServerWorker* sender);
+    void advanceWheels();
 public slots:
     void stopServer();
+    void drain();
 
 private:
+    bool isAdmitted(const QHostAddress& address) const;
+    bool isConnection(ServerWorker* worker, quint64 connectionId) const;
+    void checkLiveness();
+    void expireLogins();
     void loginUser(ServerWorker* sender, const QJsonObject& packet);
+    void completeLogin(ServerWorker* sender, const QString& userName, bool validPassword);
     bool isUserLoggedIn(const QString& username);
     void registerUser(ServerWorker* sender, const QJsonObject& packet);
+    void completeRegister(ServerWorker* sender, const QString& userName, const QString& storedPassword);
+    static void sendServerBusy(ServerWorker* destination, const char* packetType);
     void connectGroup(ServerWorker* sender, const QJsonObject& packet);
     void createGroup(ServerWorker* sender, const QJsonObject& packet);
+    void leaveGroup(ServerWorker* sender, const QJsonObject& packet);
+    void removeFromGroup(ServerWorker* member, const QString& groupName);
+    void sendPresence(const QString& groupName, const QStringList& joined, const QStringList& left);
+    void publish(const QString& groupName, const QJsonObject& packet);
+    void syncGroup(const QString& groupName);
     void packetFromLoggedOut(ServerWorker* sender, const QJsonObject& packet);
     void packetFromLoggedIn(ServerWorker* sender, const QJsonObject& packet);
     void packetFromConnectedToGroup(ServerWorker* sender, const QJsonObject& packet);
-    QJsonArray getUsernames(ServerWorker* exclude) const;
-    static QJsonArray getMessages(const QString& groupName);
+    void searchGroup(ServerWorker* sender, const QJsonObject& packet);
+    void sendHistory(ServerWorker* sender, const QJsonObject& packet);
+    void offerFile(ServerWorker* sender, const QJsonObject& packet);
+    void fileReceived(ServerWorker* sender, const QByteArray& hash, bool valid);
+    static void sendFileOfferError(ServerWorker* destination, const QString& groupName, const QString& hash,
+                                   const QString& fileName, const QString& reason);
+    void downloadFile(ServerWorker* sender, const QJsonObject& packet);
+    void postAttachment(ServerWorker* sender, const QString& groupName, const QString& fileName, const QString& hash,
+                        qint64 size);
+    void postMessage(const Message& message);
+    qint64 throttle(ServerWorker* sender, const QString& groupName);
+    static void sendSlowDown(ServerWorker* destination, const QString& groupName, qint64 retryAfter);
+    qint64 nextTimestamp();
+    void indexRemoteMessage(const QJsonObject& packet);
+    QJsonArray getUsernames(const QString& groupName, ServerWorker* exclude) const;
+    static QJsonArray messagesToJson(const QList<Message>& messages);
     static void sendPacket(ServerWorker* destination, const QJsonObject& packet);
     static bool isEqualPacketType(const QJsonValue& jsonType, const char* strType);
 
 signals:
     void stopAllClientsSig();
+    void drainedSig();
 };
 
 #endif // SERVER_CORE_H
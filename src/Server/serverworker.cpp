@@ -3,64 +3,234 @@
 #include <QJsonObject>
 #include <QFile>
 #include <QSslKey>
+#include <QDir>
+#include <QFileInfo>
+#include <QTimer>
 #include "serverworker.h"
 #include "constants.h"
+#include "filechunk.h"
+#include "packetlog.h"
 
-ServerWorker::ServerWorker(QObject* parent) : QObject(parent), serverSocket(new QSslSocket(this))
+ServerWorker::ServerWorker(QObject* parent)
+    : QObject(parent), serverSocket(nullptr), session(new Session), active(false)
 {
-#ifdef SSL_ENABLE
-    serverSocket->setProtocol(QSsl::SslV3);
-    QByteArray certificate;
-    QFile fileCertificate("ssl/ssl.cert");
-    if (fileCertificate.open(QIODevice::ReadOnly)) {
-        certificate = fileCertificate.readAll();
-        fileCertificate.close();
-    } else {
-        qWarning() << fileCertificate.errorString();
-    }
-    QSslCertificate sslCertificate(certificate);
-    serverSocket->setLocalCertificate(sslCertificate);
-
-    QByteArray privateKey;
-    QFile fileKey("ssl/ssl.key");
-    if (fileKey.open(QIODevice::ReadOnly)) {
-        privateKey = fileKey.readAll();
-        fileKey.close();
-    } else {
-        qWarning() << fileKey.errorString();
-    }
-    QSslKey sslKey(privateKey, QSsl::Rsa, QSsl::Pem, QSsl::PrivateKey, "localhost");
-    serverSocket->setPrivateKey(sslKey);
-#endif
-
-    connect(serverSocket, &QSslSocket::readyRead, this, &ServerWorker::onReadyRead);
-    connect(serverSocket, &QSslSocket::disconnected, this, &ServerWorker::disconnectedFromClientSig);
-    connect(serverSocket, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error), this,
-            &ServerWorker::errorSig);
+    createSocket();
 }
 
 ServerWorker::~ServerWorker()
 {
+    dropTransfers();
     delete serverSocket;
+    delete session.load();
+}
+
+/* plain builds get a plain socket, only ssl builds pay for QSslSocket and read the certificate, once per process */
+void ServerWorker::createSocket()
+{
+#ifdef SSL_ENABLE
+    static const QSslCertificate sslCertificate = [] {
+        QFile fileCertificate("ssl/ssl.cert");
+        if (!fileCertificate.open(QIODevice::ReadOnly)) {
+            qWarning() << fileCertificate.errorString();
+        }
+        return QSslCertificate(fileCertificate.readAll());
+    }();
+    static const QSslKey sslKey = [] {
+        QFile fileKey("ssl/ssl.key");
+        if (!fileKey.open(QIODevice::ReadOnly)) {
+            qWarning() << fileKey.errorString();
+        }
+        return QSslKey(fileKey.readAll(), QSsl::Rsa, QSsl::Pem, QSsl::PrivateKey, "localhost");
+    }();
+    auto* sslSocket = new QSslSocket(this);
+    sslSocket->setProtocol(QSsl::SslV3);
+    sslSocket->setLocalCertificate(sslCertificate);
+    sslSocket->setPrivateKey(sslKey);
+    serverSocket = sslSocket;
+#else
+    serverSocket = new QTcpSocket(this);
+#endif
+
+    connect(serverSocket, &QTcpSocket::readyRead, this, &ServerWorker::onReadyRead);
+    connect(serverSocket, &QTcpSocket::bytesWritten, this, &ServerWorker::sendChunks);
+    connect(serverSocket, &QTcpSocket::disconnected, this, &ServerWorker::dropTransfers);
+    connect(serverSocket, &QTcpSocket::disconnected, this, &ServerWorker::disconnectedFromClientSig);
+    connect(serverSocket, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error), this,
+            &ServerWorker::errorSig);
 }
 
 bool ServerWorker::setSocketDescriptor(const qintptr socketDescriptor)
 {
     const bool ret = serverSocket->setSocketDescriptor(socketDescriptor);
 #ifdef SSL_ENABLE
-    serverSocket->startServerEncryption();
+    static_cast<QSslSocket*>(serverSocket)->startServerEncryption();
 #endif
     return ret;
 }
 
+void ServerWorker::start(const qintptr socketDescriptor)
+{
+    // the core cleared the session when the last connection ended
+    Q_ASSERT(session.load(std::memory_order_acquire)->userName.isEmpty());
+    reset();
+    if (!setSocketDescriptor(socketDescriptor)) {
+        qWarning() << qPrintable(QString("unable to take the connection: %1").arg(serverSocket->errorString()));
+        emit disconnectedFromClientSig();
+    }
+}
+
+/* back to the state of a new worker, done by start() itself so nothing queued can run after the new connection */
+void ServerWorker::reset()
+{
+    dropTransfers();
+    active.store(false, std::memory_order_relaxed);
+#ifdef SSL_ENABLE
+    // a finished ssl session is not reused
+    delete serverSocket;
+    createSocket();
+#else
+    serverSocket->abort();
+#endif
+}
+
+void ServerWorker::dropTransfers()
+{
+    // unfinished uploads are not resumed
+    for (auto& upload : uploads) {
+        upload.second->file.remove();
+    }
+    uploads.clear();
+    downloads.clear();
+}
+
 void ServerWorker::sendPacket(const QJsonObject& packet)
 {
-    const QByteArray jsonData = QJsonDocument(packet).toJson();
-    qInfo() << qPrintable(QString("sending JSON to ") + getUserName() + QString("\n") + QString::fromUtf8(jsonData));
+    sendFrame(encode(packet));
+}
 
-    QDataStream socketStream(serverSocket);
-    socketStream.setVersion(SERIALIZER_VERSION);
-    socketStream << jsonData;
+void ServerWorker::sendFrame(const QByteArray& frame)
+{
+    // the length prefix is not part of the JSON
+    qCDebug(lcPackets) << qPrintable(QString("sending JSON to ") + getUserName() + QString("\n")
+                                     + QString::fromUtf8(frame.constData() + 4, frame.size() - 4));
+    serverSocket->write(frame);
+}
+
+QByteArray ServerWorker::encode(const QJsonObject& packet)
+{
+    QByteArray frame;
+    QDataStream frameStream(&frame, QIODevice::WriteOnly);
+    frameStream.setVersion(SERIALIZER_VERSION);
+    frameStream << QJsonDocument(packet).toJson(QJsonDocument::Compact);
+    return frame;
+}
+
+void ServerWorker::receiveFile(const QByteArray& hash, const qint64 size, const QString& partPath,
+                               const QString& target)
+{
+    auto upload = std::make_unique<Upload>();
+    upload->file.setFileName(partPath);
+    upload->target = target;
+    upload->size   = size;
+    if (!upload->file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << upload->file.errorString();
+        emit fileReceivedSig(hash, false);
+        return;
+    }
+    uploads[hash] = std::move(upload);
+}
+
+void ServerWorker::receiveChunk(const QByteArray& frame)
+{
+    QByteArray hash;
+    qint64 offset = 0;
+    QByteArray data;
+    if (!FileChunk::parse(frame, hash, offset, data)) {
+        return;
+    }
+    const auto found = uploads.find(hash);
+    if (found == uploads.end()) {
+        return;
+    }
+    Upload& upload = *found->second;
+    // chunks of one upload arrive in order over a single connection, anything else is a broken client
+    if (offset != upload.received || offset + data.size() > upload.size || upload.file.write(data) != data.size()) {
+        finishUpload(hash, false);
+        return;
+    }
+    upload.hasher.addData(data);
+    upload.received += data.size();
+    if (upload.received == upload.size) {
+        finishUpload(hash, upload.hasher.result() == hash);
+    }
+}
+
+void ServerWorker::finishUpload(const QByteArray& hash, bool valid)
+{
+    const auto found                     = uploads.find(hash);
+    const std::unique_ptr<Upload> upload = std::move(found->second);
+    uploads.erase(found);
+    upload->file.close();
+    bool stored = false;
+    if (valid) {
+        QDir().mkpath(QFileInfo(upload->target).path());
+        stored = upload->file.rename(upload->target);
+        // another upload of the same content may have been stored meanwhile
+        valid = stored || QFileInfo(upload->target).isFile();
+    }
+    if (!stored) {
+        upload->file.remove();
+    }
+    emit fileReceivedSig(hash, valid);
+}
+
+void ServerWorker::sendFile(const QByteArray& hash, const QString& path)
+{
+    QJsonObject packet;
+    packet[Packet::Type::TYPE]      = Packet::Type::FILE_DOWNLOAD;
+    packet[Packet::Data::FILE_HASH] = QString::fromLatin1(hash.toHex());
+    if (static_cast<int>(downloads.size()) >= maxDownloads) {
+        packet[Packet::Data::SUCCESS] = false;
+        packet[Packet::Data::REASON]  = "too many downloads at once";
+        sendPacket(packet);
+        return;
+    }
+
+    auto download = std::make_unique<Download>();
+    download->file.setFileName(path);
+    download->hash = hash;
+    if (download->file.open(QIODevice::ReadOnly)) {
+        download->size = download->file.size();
+        download->data = download->file.map(0, download->size);
+    }
+    if (download->data == nullptr) {
+        packet[Packet::Data::SUCCESS] = false;
+        packet[Packet::Data::REASON]  = "file is not available";
+        sendPacket(packet);
+        return;
+    }
+    packet[Packet::Data::SUCCESS]   = true;
+    packet[Packet::Data::FILE_SIZE] = static_cast<double>(download->size);
+    sendPacket(packet);
+    downloads.push_back(std::move(download));
+    sendChunks();
+}
+
+/* a chunk goes out only while little is queued, packets sent meanwhile never wait behind a whole file */
+void ServerWorker::sendChunks()
+{
+    while (!downloads.empty() && serverSocket->bytesToWrite() < FileChunk::SEND_WINDOW) {
+        std::unique_ptr<Download> download = std::move(downloads.front());
+        downloads.pop_front();
+        const int dataSize = static_cast<int>(qMin<qint64>(FileChunk::DATA_SIZE, download->size - download->offset));
+        serverSocket->write(FileChunk::frameHeader(download->hash, download->offset, dataSize));
+        // straight from the mapping, the file is never read into a buffer of its own
+        serverSocket->write(reinterpret_cast<const char*>(download->data + download->offset), dataSize);
+        download->offset += dataSize;
+        if (download->offset < download->size) {
+            downloads.push_back(std::move(download));
+        }
+    }
 }
 
 void ServerWorker::disconnectFromClient()
@@ -68,38 +238,68 @@ void ServerWorker::disconnectFromClient()
     serverSocket->disconnectFromHost();
 }
 
+void ServerWorker::abortConnection()
+{
+    serverSocket->abort();
+}
+
+bool ServerWorker::takeActivity()
+{
+    return active.exchange(false, std::memory_order_relaxed);
+}
+
 QString ServerWorker::getUserName() const
 {
-    userNameLock.lockForRead();
-    QString result = userName;
-    userNameLock.unlock();
-    return result;
+    return session.load(std::memory_order_acquire)->userName;
 }
 
 void ServerWorker::setUserName(const QString& name)
 {
-    userNameLock.lockForWrite();
-    userName = name;
-    userNameLock.unlock();
+    auto* next     = new Session(*session.load(std::memory_order_relaxed));
+    next->userName = name;
+    replaceSession(next);
+}
+
+void ServerWorker::clearSession()
+{
+    replaceSession(new Session);
 }
 
-QString ServerWorker::getGroupName() const
+QSet<QString> ServerWorker::getGroupNames() const
 {
-    groupNameLock.lockForRead();
-    QString result = groupName;
-    groupNameLock.unlock();
-    return result;
+    return session.load(std::memory_order_acquire)->groupNames;
 }
 
-void ServerWorker::setGroupName(const QString& name)
+bool ServerWorker::isInGroup(const QString& name) const
 {
-    groupNameLock.lockForWrite();
-    groupName = name;
-    groupNameLock.unlock();
+    return session.load(std::memory_order_acquire)->groupNames.contains(name);
+}
+
+void ServerWorker::joinGroup(const QString& name)
+{
+    auto* next = new Session(*session.load(std::memory_order_relaxed));
+    next->groupNames.insert(name);
+    replaceSession(next);
+}
+
+void ServerWorker::leaveGroup(const QString& name)
+{
+    auto* next = new Session(*session.load(std::memory_order_relaxed));
+    next->groupNames.remove(name);
+    replaceSession(next);
+}
+
+/* the worker thread may be reading the old snapshot right now, it is freed from that thread's event loop
+ * once the read is over. the core thread, the only writer, never keeps a snapshot across a change */
+void ServerWorker::replaceSession(const Session* const next)
+{
+    const std::shared_ptr<const Session> retired(session.exchange(next, std::memory_order_acq_rel));
+    QTimer::singleShot(0, this, [retired] {});
 }
 
 void ServerWorker::onReadyRead()
 {
+    active.store(true, std::memory_order_relaxed);
     QByteArray jsonData;
     QDataStream socketStream(serverSocket);
     socketStream.setVersion(SERIALIZER_VERSION);
@@ -107,6 +307,10 @@ void ServerWorker::onReadyRead()
         socketStream.startTransaction();
         socketStream >> jsonData;
         if (socketStream.commitTransaction()) {
+            if (FileChunk::isChunk(jsonData)) {
+                receiveChunk(jsonData);
+                continue;
+            }
             QJsonParseError parseError  = {0};
             const QJsonDocument jsonDoc = QJsonDocument::fromJson(jsonData, &parseError);
             if (parseError.error == QJsonParseError::NoError) {
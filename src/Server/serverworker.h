@@ -4,8 +4,14 @@
 #include <QObject>
 #include <QSslSocket>
 #include <QTcpSocket>
-#include <QReadWriteLock>
 #include <QJsonObject>
+#include <QSet>
+#include <QFile>
+#include <QCryptographicHash>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
 
 class ServerWorker : public QObject
 {
@@ -16,26 +22,75 @@ public:
     ~ServerWorker() override;
 
     virtual bool setSocketDescriptor(qintptr socketDescriptor);
+    /* takes a connection accepted by the core, runs in the worker thread. a pooled worker is reset first */
+    void start(qintptr socketDescriptor);
+    /* the getters read an immutable snapshot without locking and are safe from any thread,
+     * the setters belong to the core thread */
     QString getUserName() const;
     void setUserName(const QString& name);
-    QString getGroupName() const;
-    void setGroupName(const QString& name);
+    /* drops the user name and every group at once, before the worker goes back to the pool */
+    void clearSession();
+    QSet<QString> getGroupNames() const;
+    bool isInGroup(const QString& name) const;
+    void joinGroup(const QString& name);
+    void leaveGroup(const QString& name);
     void sendPacket(const QJsonObject& packet);
+    /* writes a packet encoded by encode(), one encoding serves every receiver of a broadcast */
+    void sendFrame(const QByteArray& frame);
+    static QByteArray encode(const QJsonObject& packet);
+    /* takes the chunks of a file into partPath and moves it to target once its sha-256 matches */
+    void receiveFile(const QByteArray& hash, qint64 size, const QString& partPath, const QString& target);
+    /* streams a stored file in chunks between the other packets */
+    void sendFile(const QByteArray& hash, const QString& path);
+    /* whether the client sent anything since the last call, safe from any thread */
+    bool takeActivity();
 public slots:
     void disconnectFromClient();
+    /* drops the connection without waiting for unsent data, a dead peer would never take it */
+    void abortConnection();
 private slots:
     void onReadyRead();
+    /* removes the part files of unfinished uploads and stops serving files */
+    void dropTransfers();
+    void sendChunks();
 signals:
     void packetReceivedSig(const QJsonObject& packet);
     void disconnectedFromClientSig();
     void errorSig();
+    void fileReceivedSig(const QByteArray& hash, bool valid);
 
 private:
-    QSslSocket* serverSocket;
-    QString userName;
-    QString groupName;
-    mutable QReadWriteLock userNameLock;
-    mutable QReadWriteLock groupNameLock;
+    struct Upload {
+        QFile file;
+        QCryptographicHash hasher{QCryptographicHash::Sha256};
+        QString target;
+        qint64 size     = 0;
+        qint64 received = 0;
+    };
+    struct Download {
+        QFile file;
+        const uchar* data = nullptr; // mapping of the whole file
+        QByteArray hash;
+        qint64 size   = 0;
+        qint64 offset = 0;
+    };
+    struct Session {
+        QString userName;
+        QSet<QString> groupNames;
+    };
+    void replaceSession(const Session* next);
+    void reset();
+    void createSocket();
+    void receiveChunk(const QByteArray& frame);
+    void finishUpload(const QByteArray& hash, bool valid);
+
+private:
+    QTcpSocket* serverSocket; // a QSslSocket in ssl builds
+    std::atomic<const Session*> session;
+    std::map<QByteArray, std::unique_ptr<Upload>> uploads; // raw sha-256 -> upload
+    std::deque<std::unique_ptr<Download>> downloads;       // served round robin
+    std::atomic<bool> active;
+    static constexpr int maxDownloads = 4;
 };
 
 #endif // SERVER_WORKER_H
@@ -0,0 +1,89 @@
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QDebug>
+#include <random>
+#include "sessionstore.h"
+
+SessionStore::SessionStore(const QString& path) : path(path)
+{
+}
+
+QString SessionStore::issue(const QString& userName)
+{
+    static std::random_device randomDevice;
+    QByteArray token(tokenSize, Qt::Uninitialized);
+    for (char& byte : token) {
+        byte = static_cast<char>(randomDevice() & 0xff);
+    }
+    const QString key = QString::fromLatin1(token.toHex());
+    issued.insert(key, {userName, QDateTime::currentMSecsSinceEpoch() + sessionTtl});
+    return key;
+}
+
+bool SessionStore::save()
+{
+    // tokens of an earlier restart may still wait for their owners
+    QHash<QString, Session> sessions = load();
+    for (auto it = issued.cbegin(); it != issued.cend(); ++it) {
+        sessions.insert(it.key(), it.value());
+    }
+    issued.clear();
+    return write(path, sessions);
+}
+
+QString SessionStore::redeem(const QString& token)
+{
+    QHash<QString, Session> sessions = load();
+    const Session session            = sessions.take(token);
+    if (session.userName.isEmpty()) {
+        return {};
+    }
+    write(path, sessions);
+    if (session.expiresAt < QDateTime::currentMSecsSinceEpoch()) {
+        return {};
+    }
+    return session.userName;
+}
+
+QHash<QString, SessionStore::Session> SessionStore::load() const
+{
+    QHash<QString, Session> sessions;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return sessions;
+    }
+    const qint64 now               = QDateTime::currentMSecsSinceEpoch();
+    const QJsonObject jsonSessions = QJsonDocument::fromJson(file.readAll()).object();
+    for (auto it = jsonSessions.constBegin(); it != jsonSessions.constEnd(); ++it) {
+        const QJsonObject jsonSession = it.value().toObject();
+        Session session{jsonSession.value("user").toString(),
+                        static_cast<qint64>(jsonSession.value("expires").toDouble())};
+        if (session.expiresAt >= now) {
+            sessions.insert(it.key(), session);
+        }
+    }
+    return sessions;
+}
+
+bool SessionStore::write(const QString& path, const QHash<QString, Session>& sessions)
+{
+    QJsonObject jsonSessions;
+    for (auto it = sessions.cbegin(); it != sessions.cend(); ++it) {
+        QJsonObject jsonSession;
+        jsonSession["user"]    = it->userName;
+        jsonSession["expires"] = static_cast<double>(it->expiresAt);
+        jsonSessions[it.key()] = jsonSession;
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << qPrintable(QString("unable to write sessions: %1").arg(file.errorString()));
+        return false;
+    }
+    // the tokens are as good as passwords
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+    file.write(QJsonDocument(jsonSessions).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
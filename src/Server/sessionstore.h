@@ -0,0 +1,33 @@
+#ifndef SESSION_STORE_H
+#define SESSION_STORE_H
+
+#include <QString>
+#include <QHash>
+#include <QDateTime>
+
+/* one-time resume tokens handed out on drain, shared with the next server process through a file */
+class SessionStore
+{
+public:
+    explicit SessionStore(const QString& path);
+    QString issue(const QString& userName);
+    bool save();
+    /* returns the user name the token was issued to, empty if unknown or expired */
+    QString redeem(const QString& token);
+
+private:
+    struct Session {
+        QString userName;
+        qint64 expiresAt = 0;
+    };
+    QHash<QString, Session> load() const;
+    static bool write(const QString& path, const QHash<QString, Session>& sessions);
+
+private:
+    const QString path;
+    QHash<QString, Session> issued;
+    static constexpr qint64 sessionTtl = 1000 * 60 * 5;
+    static constexpr int tokenSize     = 16;
+};
+
+#endif // SESSION_STORE_H
@@ -1,4 +1,5 @@
 drop table "message";
-drop table group_user;
+drop table if exists group_user;
 drop table "user";
-drop table "group";
\ No newline at end of file
+drop table "group";
+drop table schema_version;
\ No newline at end of file
@@ -0,0 +1,26 @@
+-- the schema as sql/create_tables.sql used to create it, existing databases pass through unchanged
+create table if not exists "user"
+(
+    id       serial primary key,
+    name     varchar(32) unique not null,
+    password varchar(128)       not null
+);
+
+create table if not exists "group"
+(
+    id       serial primary key,
+    name     varchar(32) unique not null,
+    password varchar(128)       not null
+);
+
+create table if not exists "message"
+(
+    id          serial primary key,
+    group_name  varchar(32)   not null,
+    sender_name varchar(32)   not null,
+    message     varchar(2048) not null,
+    time        varchar(6)    not null
+);
+
+alter table "message"
+    add column if not exists created_at bigint not null default 0;
@@ -0,0 +1,33 @@
+-- messages are keyed by (group_id, seq), seq is the per group message id clients see
+alter table "group"
+    add column if not exists last_seq bigint not null default 0;
+
+create table message_v2
+(
+    group_id   int           not null,
+    seq        bigint        not null,
+    user_id    int           not null,
+    text       varchar(2048) not null,
+    time       varchar(6)    not null,
+    created_at bigint        not null default 0,
+
+    constraint message_v2_pk primary key (group_id, seq),
+    constraint message_group_fk foreign key (group_id) references "group" (id),
+    constraint message_user_fk foreign key (user_id) references "user" (id)
+);
+
+-- old ids are kept as seq, they already grow within a group and clients cache by them
+insert into message_v2 (group_id, seq, user_id, text, time, created_at)
+select g.id, m.id, u.id, m.message, m.time, m.created_at
+from "message" m
+         inner join "group" g on g.name = m.group_name
+         inner join "user" u on u.name = m.sender_name;
+
+update "group" g
+set last_seq = coalesce((select max(m.seq) from message_v2 m where m.group_id = g.id), 0);
+
+drop table "message";
+alter table message_v2 rename to "message";
+alter table "message" rename constraint message_v2_pk to message_pk;
+create index message_group_created_at on "message" (group_id, created_at);
+cluster "message" using message_pk;
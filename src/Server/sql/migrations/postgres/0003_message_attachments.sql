@@ -0,0 +1,5 @@
+-- a message with an attachment carries the file name as its text, the file lives in the server file store
+alter table message
+    add column attachment varchar(64);
+alter table message
+    add column attachment_size bigint not null default 0;
@@ -0,0 +1,24 @@
+-- the schema the server created on start before migrations existed
+create table if not exists "user"
+(
+    id       integer primary key autoincrement,
+    name     varchar(32) unique not null,
+    password varchar(128)       not null
+);
+
+create table if not exists "group"
+(
+    id       integer primary key autoincrement,
+    name     varchar(32) unique not null,
+    password varchar(128)       not null
+);
+
+create table if not exists message
+(
+    id          integer primary key autoincrement,
+    group_name  varchar(32)   not null,
+    sender_name varchar(32)   not null,
+    message     varchar(2048) not null,
+    time        varchar(6)    not null,
+    created_at  bigint        not null default 0
+);
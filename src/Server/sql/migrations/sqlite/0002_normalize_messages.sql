@@ -0,0 +1,30 @@
+-- messages are keyed by (group_id, seq), seq is the per group message id clients see
+alter table "group"
+    add column last_seq integer not null default 0;
+
+-- without rowid keeps the rows clustered by the primary key
+create table message_v2
+(
+    group_id   integer       not null references "group" (id),
+    seq        integer       not null,
+    user_id    integer       not null references "user" (id),
+    text       varchar(2048) not null,
+    time       varchar(6)    not null,
+    created_at bigint        not null default 0,
+
+    primary key (group_id, seq)
+) without rowid;
+
+-- old ids are kept as seq, they already grow within a group and clients cache by them
+insert into message_v2 (group_id, seq, user_id, text, time, created_at)
+select g.id, m.id, u.id, m.message, m.time, m.created_at
+from message m
+         inner join "group" g on g.name = m.group_name
+         inner join "user" u on u.name = m.sender_name;
+
+update "group"
+set last_seq = coalesce((select max(m.seq) from message_v2 m where m.group_id = "group".id), 0);
+
+drop table message;
+alter table message_v2 rename to message;
+create index message_group_created_at on message (group_id, created_at);
@@ -0,0 +1,322 @@
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QStringList>
+#include "sqlstorage.h"
+#include "connectionpool.h"
+#include "migrationrunner.h"
+#include "metrics.h"
+
+namespace {
+    Message readMessage(const QSqlQuery& query, const QString& groupName)
+    {
+        Message message(groupName, query.value("sender_name").toString(), query.value("message").toString(),
+                        query.value("time").toString(), query.value("id").toLongLong(),
+                        query.value("created_at").toLongLong());
+        message.setAttachment(query.value("attachment").toString(), query.value("attachment_size").toLongLong());
+        return message;
+    }
+} // namespace
+
+SqlStorage::SqlStorage(const Dialect dialect) : dialect(dialect)
+{
+    auto conn = ConnectionPool::getConnection();
+    if (!MigrationRunner::migrate(conn, dialect == Dialect::Postgres ? "postgres" : "sqlite")) {
+        qCritical() << "database schema is not up to date";
+    }
+    ConnectionPool::releaseConnection(conn);
+}
+
+bool SqlStorage::isUserExist(const QString& userName)
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+    auto conn = ConnectionPool::getConnection();
+    QSqlQuery query = ConnectionPool::prepare(conn, R"(select id from "user" where "name" = :name)");
+    query.bindValue(":name", userName);
+    query.exec();
+
+    int id = 0;
+    while (query.next()) {
+        id = query.value("id").toInt();
+    }
+    ConnectionPool::releaseConnection(conn);
+    Metrics::increment("db.user_exist_us", elapsed.nsecsElapsed() / 1000);
+    Metrics::increment("db.user_exist_calls");
+
+    return id != 0;
+}
+
+bool SqlStorage::addUser(const QString& userName, const QString& password)
+{
+    auto conn = ConnectionPool::getConnection();
+    // a taken name is reported by the insert itself instead of a separate lookup
+    const QString sql = dialect == Dialect::Postgres ? R"(insert into "user" (name, password)
+values (:name, :password)
+on conflict (name) do nothing)"
+                                                     : R"(insert or ignore into "user" (name, password)
+values (:name, :password))";
+    QSqlQuery query = ConnectionPool::prepare(conn, sql);
+    query.bindValue(":name", userName);
+    query.bindValue(":password", password);
+    const bool added = query.exec() && query.numRowsAffected() == 1;
+    ConnectionPool::releaseConnection(conn);
+
+    return added;
+}
+
+void SqlStorage::updateUserPassword(const QString& userName, const QString& password)
+{
+    auto conn = ConnectionPool::getConnection();
+    QSqlQuery query = ConnectionPool::prepare(conn, R"(update "user" set password = :password where "name" = :name)");
+    query.bindValue(":name", userName);
+    query.bindValue(":password", password);
+    query.exec();
+    ConnectionPool::releaseConnection(conn);
+}
+
+void SqlStorage::addGroup(const QString& groupName, const QString& password)
+{
+    auto conn = ConnectionPool::getConnection();
+    QSqlQuery query = ConnectionPool::prepare(conn, R"(insert into "group" (name, password)
+values (:name, :password))");
+    query.bindValue(":name", groupName);
+    query.bindValue(":password", password);
+    query.exec();
+    ConnectionPool::releaseConnection(conn);
+}
+
+QString SqlStorage::fetchUserPassword(const QString& userName)
+{
+    auto conn = ConnectionPool::getConnection();
+    QSqlQuery query = ConnectionPool::prepare(conn, R"(select password from "user" where "name" = :name)");
+    query.bindValue(":name", userName);
+    query.exec();
+
+    QString password;
+    while (query.next()) {
+        password = query.value("password").toString();
+    }
+    ConnectionPool::releaseConnection(conn);
+
+    return password;
+}
+
+bool SqlStorage::isGroupExist(const QString& groupName)
+{
+    auto conn = ConnectionPool::getConnection();
+    QSqlQuery query = ConnectionPool::prepare(conn, R"(select id from "group" where "name" = :name)");
+    query.bindValue(":name", groupName);
+    query.exec();
+
+    int id = 0;
+    while (query.next()) {
+        id = query.value("id").toInt();
+    }
+    ConnectionPool::releaseConnection(conn);
+
+    return id != 0;
+}
+
+QString SqlStorage::fetchGroupPassword(const QString& groupName)
+{
+    auto conn = ConnectionPool::getConnection();
+    QSqlQuery query = ConnectionPool::prepare(conn, R"(select password from "group" where "name" = :name)");
+    query.bindValue(":name", groupName);
+    query.exec();
+
+    QString password;
+    while (query.next()) {
+        password = query.value("password").toString();
+    }
+    ConnectionPool::releaseConnection(conn);
+
+    return password;
+}
+
+db::GroupJoin SqlStorage::fetchGroupJoin(const QString& groupName, const qint64 afterId)
+{
+    auto conn = ConnectionPool::getConnection();
+    // no row means no group, a row without id is a group with nothing new
+    QSqlQuery query = ConnectionPool::prepare(conn, R"(
+select g.password, m.seq as id, u.name as sender_name, m.text as message, m.time, m.created_at,
+       m.attachment, m.attachment_size
+from "group" g
+         left join message m on m.group_id = g.id and m.seq > :after_id
+         left join "user" u on u.id = m.user_id
+where g.name = :name
+order by m.seq)");
+    query.bindValue(":name", groupName);
+    query.bindValue(":after_id", afterId);
+    query.exec();
+
+    db::GroupJoin join;
+    while (query.next()) {
+        join.exists   = true;
+        join.password = query.value("password").toString();
+        if (query.isNull("id")) {
+            continue;
+        }
+        join.messages.push_back(readMessage(query, groupName));
+    }
+    ConnectionPool::releaseConnection(conn);
+
+    return join;
+}
+
+qint64 SqlStorage::addMessage(const Message& message)
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+    auto conn = ConnectionPool::getConnection();
+    qint64 id = 0;
+    // the group row hands out the next seq, concurrent writers to a group queue on its lock
+    if (dialect == Dialect::Postgres) {
+        QSqlQuery query = ConnectionPool::prepare(conn, R"(
+with g as (update "group" set last_seq = last_seq + 1 where name = :group_name returning id, last_seq)
+insert into message (group_id, seq, user_id, text, time, created_at, attachment, attachment_size)
+select g.id, g.last_seq, u.id, :message, :time, :created_at, :attachment, :attachment_size
+from g, "user" u
+where u.name = :sender_name
+returning seq)");
+        query.bindValue(":group_name", message.getGroupName());
+        query.bindValue(":sender_name", message.getSender());
+        query.bindValue(":message", message.getMessage().toString());
+        query.bindValue(":time", message.getTime());
+        query.bindValue(":created_at", message.getTimestamp());
+        query.bindValue(":attachment",
+                        message.getAttachment().isEmpty() ? QVariant() : message.getAttachment().toString());
+        query.bindValue(":attachment_size", message.getAttachmentSize());
+        query.exec();
+        while (query.next()) {
+            id = query.value("seq").toLongLong();
+        }
+    } else {
+        // older SQLite versions have no "returning", the seq is read back in the same transaction
+        conn.transaction();
+        QSqlQuery nextSeq =
+            ConnectionPool::prepare(conn, R"(update "group" set last_seq = last_seq + 1 where name = :group_name)");
+        nextSeq.bindValue(":group_name", message.getGroupName());
+        nextSeq.exec();
+        QSqlQuery insert = ConnectionPool::prepare(conn, R"(
+insert into message (group_id, seq, user_id, text, time, created_at, attachment, attachment_size)
+select g.id, g.last_seq, u.id, :message, :time, :created_at, :attachment, :attachment_size
+from "group" g, "user" u
+where g.name = :group_name and u.name = :sender_name)");
+        insert.bindValue(":group_name", message.getGroupName());
+        insert.bindValue(":sender_name", message.getSender());
+        insert.bindValue(":message", message.getMessage().toString());
+        insert.bindValue(":time", message.getTime());
+        insert.bindValue(":created_at", message.getTimestamp());
+        insert.bindValue(":attachment",
+                         message.getAttachment().isEmpty() ? QVariant() : message.getAttachment().toString());
+        insert.bindValue(":attachment_size", message.getAttachmentSize());
+        if (insert.exec() && insert.numRowsAffected() == 1) {
+            QSqlQuery lastSeq =
+                ConnectionPool::prepare(conn, R"(select last_seq from "group" where name = :group_name)");
+            lastSeq.bindValue(":group_name", message.getGroupName());
+            lastSeq.exec();
+            while (lastSeq.next()) {
+                id = lastSeq.value("last_seq").toLongLong();
+            }
+        }
+        conn.commit();
+    }
+    ConnectionPool::releaseConnection(conn);
+    Metrics::increment("db.add_message_us", elapsed.nsecsElapsed() / 1000);
+    Metrics::increment("db.add_message_calls");
+
+    return id;
+}
+
+QList<Message> SqlStorage::fetchMessages(const QString& groupName, const qint64 afterId)
+{
+    auto conn = ConnectionPool::getConnection();
+    QSqlQuery query = ConnectionPool::prepare(conn, R"(
+select m.seq as id, u.name as sender_name, m.text as message, m.time, m.created_at,
+       m.attachment, m.attachment_size
+from message m
+         inner join "user" u on u.id = m.user_id
+where m.group_id = (select id from "group" where name = :name)
+  and m.seq > :after_id
+order by m.seq)");
+    query.bindValue(":name", groupName);
+    query.bindValue(":after_id", afterId);
+    query.exec();
+
+    QList<Message> messages;
+    while (query.next()) {
+        messages.push_back(readMessage(query, groupName));
+    }
+    ConnectionPool::releaseConnection(conn);
+
+    return messages;
+}
+
+QList<Message> SqlStorage::fetchMessagesByIds(const QString& groupName, const QVector<qint64>& ids)
+{
+    QList<Message> messages;
+    if (ids.isEmpty()) {
+        return messages;
+    }
+    QStringList placeholders;
+    for (int i = 0; i < ids.size(); ++i) {
+        placeholders.push_back(QString(":id%1").arg(i));
+    }
+
+    auto conn = ConnectionPool::getConnection();
+    QSqlQuery query(conn);
+    query.prepare(QString(R"(select m.seq as id, u.name as sender_name, m.text as message, m.time, m.created_at,
+       m.attachment, m.attachment_size
+from message m
+         inner join "user" u on u.id = m.user_id
+where m.group_id = (select id from "group" where name = :name)
+  and m.seq in (%1)
+order by m.seq)")
+                      .arg(placeholders.join(", ")));
+    query.bindValue(":name", groupName);
+    for (int i = 0; i < ids.size(); ++i) {
+        query.bindValue(placeholders.at(i), ids.at(i));
+    }
+    query.exec();
+
+    while (query.next()) {
+        messages.push_back(readMessage(query, groupName));
+    }
+    ConnectionPool::releaseConnection(conn);
+
+    return messages;
+}
+
+QList<Message> SqlStorage::fetchMessagesInRange(const QString& groupName, const qint64 from, const qint64 to,
+                                                const qint64 afterId, const int limit)
+{
+    auto conn = ConnectionPool::getConnection();
+    // a range scan of message_group_created_at, a page goes on after the (created_at, seq) of the last row
+    QSqlQuery query = ConnectionPool::prepare(conn, R"(
+select m.seq as id, u.name as sender_name, m.text as message, m.time, m.created_at,
+       m.attachment, m.attachment_size
+from message m
+         inner join "user" u on u.id = m.user_id
+where m.group_id = (select id from "group" where name = :name)
+  and (m.created_at > :from or (m.created_at = :from_tie and m.seq > :after_id))
+  and m.created_at < :to
+order by m.created_at, m.seq
+limit :limit)");
+    query.bindValue(":name", groupName);
+    query.bindValue(":from", from);
+    query.bindValue(":from_tie", from);
+    query.bindValue(":to", to);
+    query.bindValue(":after_id", afterId);
+    query.bindValue(":limit", limit);
+    query.exec();
+
+    QList<Message> messages;
+    while (query.next()) {
+        messages.push_back(readMessage(query, groupName));
+    }
+    ConnectionPool::releaseConnection(conn);
+
+    return messages;
+}
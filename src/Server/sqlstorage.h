@@ -0,0 +1,35 @@
+#ifndef SQL_STORAGE_H
+#define SQL_STORAGE_H
+
+#include "storage.h"
+
+/* Postgres or SQLite through ConnectionPool, the schema comes from the bundled migrations */
+class SqlStorage : public Storage
+{
+public:
+    enum class Dialect
+    {
+        Postgres,
+        Sqlite
+    };
+
+    explicit SqlStorage(Dialect dialect);
+    bool isUserExist(const QString& userName) override;
+    bool isGroupExist(const QString& groupName) override;
+    bool addUser(const QString& userName, const QString& password) override;
+    void updateUserPassword(const QString& userName, const QString& password) override;
+    void addGroup(const QString& groupName, const QString& password) override;
+    QString fetchUserPassword(const QString& userName) override;
+    QString fetchGroupPassword(const QString& groupName) override;
+    db::GroupJoin fetchGroupJoin(const QString& groupName, qint64 afterId) override;
+    qint64 addMessage(const Message& message) override;
+    QList<Message> fetchMessages(const QString& groupName, qint64 afterId) override;
+    QList<Message> fetchMessagesByIds(const QString& groupName, const QVector<qint64>& ids) override;
+    QList<Message> fetchMessagesInRange(const QString& groupName, qint64 from, qint64 to, qint64 afterId,
+                                        int limit) override;
+
+private:
+    const Dialect dialect;
+};
+
+#endif // SQL_STORAGE_H
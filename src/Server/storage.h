@@ -0,0 +1,30 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <QList>
+#include <QString>
+#include <QVector>
+#include "db.h"
+#include "message.h"
+
+/* persistence backend behind the db:: functions */
+class Storage
+{
+public:
+    virtual ~Storage() = default;
+    virtual bool isUserExist(const QString& userName) = 0;
+    virtual bool isGroupExist(const QString& groupName) = 0;
+    virtual bool addUser(const QString& userName, const QString& password) = 0;
+    virtual void updateUserPassword(const QString& userName, const QString& password) = 0;
+    virtual void addGroup(const QString& groupName, const QString& password) = 0;
+    virtual QString fetchUserPassword(const QString& userName) = 0;
+    virtual QString fetchGroupPassword(const QString& groupName) = 0;
+    virtual db::GroupJoin fetchGroupJoin(const QString& groupName, qint64 afterId) = 0;
+    virtual qint64 addMessage(const Message& message) = 0;
+    virtual QList<Message> fetchMessages(const QString& groupName, qint64 afterId) = 0;
+    virtual QList<Message> fetchMessagesByIds(const QString& groupName, const QVector<qint64>& ids) = 0;
+    virtual QList<Message> fetchMessagesInRange(const QString& groupName, qint64 from, qint64 to, qint64 afterId,
+                                                int limit) = 0;
+};
+
+#endif // STORAGE_H
@@ -0,0 +1,92 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <array>
+
+/* hierarchical timer wheel, level n has 64 slots of 64^n ticks each. scheduling and cancelling touch one slot,
+ * a tick expires one slot of the lowest level and now and then sorts a slot of a higher level down */
+template<typename Key>
+class TimerWheel
+{
+public:
+    /* key expires the given number of ticks from now, a key scheduled again only keeps the new expiry */
+    void schedule(const Key& key, const qint64 ticks)
+    {
+        cancel(key);
+        place(key, now + qBound<qint64>(1, ticks, maxTicks));
+    }
+
+    void cancel(const Key& key)
+    {
+        const auto position = positions.find(key);
+        if (position != positions.end()) {
+            wheel[position->level][position->slot].remove(key);
+            positions.erase(position);
+        }
+    }
+
+    [[nodiscard]] int size() const
+    {
+        return positions.size();
+    }
+
+    /* moves the wheel one tick on and returns the keys that expired on it */
+    QList<Key> advance()
+    {
+        ++now;
+        // from the top, a slot sorted down may land in the slot of a lower level that is due as well
+        for (int level = levels - 1; level > 0; --level) {
+            if ((now & ((qint64(1) << (slotBits * level)) - 1)) != 0) {
+                continue;
+            }
+            QSet<Key> due;
+            due.swap(wheel[level][slotOf(now, level)]);
+            for (const Key& key : due) {
+                place(key, positions.value(key).expiry);
+            }
+        }
+        QSet<Key> due;
+        due.swap(wheel[0][slotOf(now, 0)]);
+        for (const Key& key : due) {
+            positions.remove(key);
+        }
+        return due.values();
+    }
+
+private:
+    struct Position {
+        qint64 expiry = 0;
+        int level     = 0;
+        int slot      = 0;
+    };
+
+    void place(const Key& key, const qint64 expiry)
+    {
+        const qint64 delta = expiry - now;
+        int level          = 0;
+        while (level < levels - 1 && delta >= (qint64(1) << (slotBits * (level + 1)))) {
+            ++level;
+        }
+        const int slot = slotOf(expiry, level);
+        wheel[level][slot].insert(key);
+        positions.insert(key, {expiry, level, slot});
+    }
+
+    static int slotOf(const qint64 tick, const int level)
+    {
+        return static_cast<int>((tick >> (slotBits * level)) & (slotCount - 1));
+    }
+
+    static constexpr int slotBits    = 6;
+    static constexpr int slotCount   = 1 << slotBits;
+    static constexpr int levels      = 4;
+    static constexpr qint64 maxTicks = (qint64(1) << (slotBits * levels)) - 1;
+    std::array<std::array<QSet<Key>, slotCount>, levels> wheel;
+    QHash<Key, Position> positions;
+    qint64 now = 0;
+};
+
+#endif // TIMER_WHEEL_H
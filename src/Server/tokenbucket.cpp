@@ -0,0 +1,28 @@
+#include <cmath>
+#include "tokenbucket.h"
+
+TokenBucket::TokenBucket(const int rate, const int burst)
+    : rate(qMax(rate, 0) / 1000.0), burst(qMax(burst, 1)), tokens(this->burst), updated(-1)
+{
+}
+
+bool TokenBucket::isEnabled() const
+{
+    return rate > 0;
+}
+
+qint64 TokenBucket::take(const qint64 now)
+{
+    if (!isEnabled()) {
+        return 0;
+    }
+    if (updated >= 0 && now > updated) {
+        tokens = qMin(burst, tokens + (now - updated) * rate);
+    }
+    updated = qMax(updated, now);
+    if (tokens >= 1) {
+        tokens -= 1;
+        return 0;
+    }
+    return qMax<qint64>(static_cast<qint64>(std::ceil((1 - tokens) / rate)), 1);
+}
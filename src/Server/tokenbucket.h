@@ -0,0 +1,23 @@
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+
+#include <QtGlobal>
+
+/* lets rate events per second through on average and up to burst of them at once,
+ * a bucket with a rate of 0 lets everything through */
+class TokenBucket
+{
+public:
+    explicit TokenBucket(int rate = 0, int burst = 0);
+    [[nodiscard]] bool isEnabled() const;
+    /* now is in ms of a monotonic clock, returns 0 when a token was taken or else the ms until one is there */
+    qint64 take(qint64 now);
+
+private:
+    double rate; // tokens per ms
+    double burst;
+    double tokens;
+    qint64 updated;
+};
+
+#endif // TOKEN_BUCKET_H
@@ -18,22 +18,47 @@ namespace Packet {
         constexpr const char* const REGISTER      = "register";
         constexpr const char* const CONNECT_GROUP = "connect_group";
         constexpr const char* const CREATE_GROUP  = "create_group";
-        constexpr const char* const USER_JOINED   = "user_joined";
-        constexpr const char* const USER_LEFT     = "user_left";
+        constexpr const char* const LEAVE_GROUP   = "leave_group";
+        constexpr const char* const PRESENCE      = "presence";
+        constexpr const char* const DRAIN         = "drain";
         constexpr const char* const MESSAGE       = "message";
+        constexpr const char* const SEARCH        = "search";
+        constexpr const char* const HISTORY       = "history";
+        constexpr const char* const FILE_OFFER    = "file_offer";
+        constexpr const char* const FILE_DOWNLOAD = "file_download";
+        constexpr const char* const SLOW_DOWN     = "slow_down";
+        constexpr const char* const PING          = "ping";
+        constexpr const char* const PONG          = "pong";
         constexpr const char* const INFORM_JOINER = "inform_joiner";
     } // namespace Type
     namespace Data {
-        constexpr const char* const USERNAME   = "username";
-        constexpr const char* const GROUP_NAME = "group_name";
-        constexpr const char* const PASSWORD   = "password";
-        constexpr const char* const TEXT       = "text";
-        constexpr const char* const SENDER     = "sender";
-        constexpr const char* const SUCCESS    = "success";
-        constexpr const char* const REASON     = "reason";
-        constexpr const char* const USERNAMES  = "usernames";
-        constexpr const char* const MESSAGES   = "messages";
-        constexpr const char* const TIME       = "time";
+        constexpr const char* const USERNAME    = "username";
+        constexpr const char* const GROUP_NAME  = "group_name";
+        constexpr const char* const PASSWORD    = "password";
+        constexpr const char* const TEXT        = "text";
+        constexpr const char* const SENDER      = "sender";
+        constexpr const char* const SUCCESS     = "success";
+        constexpr const char* const REASON      = "reason";
+        constexpr const char* const USERNAMES   = "usernames";
+        constexpr const char* const MESSAGES    = "messages";
+        constexpr const char* const TIME        = "time";
+        constexpr const char* const ID          = "id";
+        constexpr const char* const LAST_ID     = "last_id";
+        constexpr const char* const JOINED      = "joined";
+        constexpr const char* const LEFT        = "left";
+        constexpr const char* const TOKEN       = "token";
+        constexpr const char* const RETRY_AFTER = "retry_after";
+        constexpr const char* const QUERY       = "query";
+        constexpr const char* const BEFORE_ID   = "before_id";
+        constexpr const char* const HAS_MORE    = "has_more";
+        constexpr const char* const TIMESTAMP   = "timestamp";
+        constexpr const char* const FROM        = "from";
+        constexpr const char* const TO          = "to";
+        constexpr const char* const FILE_NAME   = "file_name";
+        constexpr const char* const FILE_SIZE   = "file_size";
+        constexpr const char* const FILE_HASH   = "file_hash";
+        constexpr const char* const OFFSET      = "offset";
+        constexpr const char* const EPOCH       = "epoch";
     } // namespace Data
 } // namespace Packet
 
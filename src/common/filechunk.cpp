@@ -0,0 +1,32 @@
+#include <QtEndian>
+#include <cstring>
+#include "filechunk.h"
+
+bool FileChunk::isChunk(const QByteArray& frame)
+{
+    return !frame.isEmpty() && frame.at(0) == MARKER;
+}
+
+QByteArray FileChunk::frameHeader(const QByteArray& hash, const qint64 offset, const int dataSize)
+{
+    Q_ASSERT(hash.size() == HASH_SIZE);
+    QByteArray header(4 + HEADER_SIZE, Qt::Uninitialized);
+    auto* raw = reinterpret_cast<uchar*>(header.data());
+    // the length prefix QDataStream writes in front of a byte array
+    qToBigEndian<quint32>(static_cast<quint32>(HEADER_SIZE + dataSize), raw);
+    raw[4] = static_cast<uchar>(MARKER);
+    memcpy(raw + 5, hash.constData(), HASH_SIZE);
+    qToBigEndian<qint64>(offset, raw + 5 + HASH_SIZE);
+    return header;
+}
+
+bool FileChunk::parse(const QByteArray& frame, QByteArray& hash, qint64& offset, QByteArray& data)
+{
+    if (frame.size() < HEADER_SIZE || !isChunk(frame) || frame.size() - HEADER_SIZE > DATA_SIZE) {
+        return false;
+    }
+    hash   = frame.mid(1, HASH_SIZE);
+    offset = qFromBigEndian<qint64>(reinterpret_cast<const uchar*>(frame.constData() + 1 + HASH_SIZE));
+    data   = frame.mid(HEADER_SIZE);
+    return offset >= 0;
+}
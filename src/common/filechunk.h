@@ -0,0 +1,22 @@
+#ifndef MESSENGER_FILE_CHUNK_H
+#define MESSENGER_FILE_CHUNK_H
+
+#include <QByteArray>
+
+/* file data travels in binary frames between the JSON packets, a frame is a QDataStream byte array of
+ * the marker, the raw sha-256 of the whole file, the big endian offset and the data,
+ * JSON never starts with the marker */
+namespace FileChunk {
+    constexpr char MARKER        = '\0';
+    constexpr int HASH_SIZE      = 32;
+    constexpr int HEADER_SIZE    = 1 + HASH_SIZE + 8;
+    constexpr int DATA_SIZE      = 64 * 1024;
+    constexpr qint64 SEND_WINDOW = 4 * DATA_SIZE; // unsent bytes after which the next chunk waits
+
+    bool isChunk(const QByteArray& frame);
+    /* length prefix and header of a frame, the data is written right after it without being copied into one */
+    QByteArray frameHeader(const QByteArray& hash, qint64 offset, int dataSize);
+    bool parse(const QByteArray& frame, QByteArray& hash, qint64& offset, QByteArray& data);
+} // namespace FileChunk
+
+#endif // MESSENGER_FILE_CHUNK_H
@@ -1,25 +1,64 @@
+#include <QDateTime>
 #include "message.h"
+#include "stringinterner.h"
 
-Message::Message(const QString& groupName, const QString& sender, const QString& message, const QString& time)
-    : groupName(groupName), sender(sender), message(message), time(time)
+Message::Message(const QString& groupName, const QString& sender, const QString& message, const QString& time,
+                 const qint64 id, const qint64 timestamp)
+    : text(timestamp != 0 ? message : message + time), id(id), timestamp(timestamp),
+      groupId(StringInterner::intern(groupName)), senderId(StringInterner::intern(sender)),
+      messageSize(message.size()), timeSize(timestamp != 0 ? 0 : time.size())
 {}
 
 const QString& Message::getGroupName() const
 {
-    return groupName;
+    return StringInterner::lookup(groupId);
 }
 
 const QString& Message::getSender() const
 {
-    return sender;
+    return StringInterner::lookup(senderId);
 }
 
-const QString& Message::getMessage() const
+QStringRef Message::getMessage() const
 {
-    return message;
+    return text.leftRef(messageSize);
 }
 
-const QString& Message::getTime() const
+QString Message::getTime() const
 {
-    return time;
-}
\ No newline at end of file
+    if (timestamp != 0) {
+        return QDateTime::fromMSecsSinceEpoch(timestamp).toString("hh:mm");
+    }
+    return text.mid(messageSize, timeSize);
+}
+
+qint64 Message::getId() const
+{
+    return id;
+}
+
+void Message::setId(const qint64 id)
+{
+    this->id = id;
+}
+
+qint64 Message::getTimestamp() const
+{
+    return timestamp;
+}
+
+QStringRef Message::getAttachment() const
+{
+    return text.midRef(messageSize + timeSize);
+}
+
+qint64 Message::getAttachmentSize() const
+{
+    return attachmentSize;
+}
+
+void Message::setAttachment(const QString& hash, const qint64 size)
+{
+    text           = text.left(messageSize + timeSize) + hash;
+    attachmentSize = size;
+}
@@ -2,22 +2,44 @@
 #define MESSENGER_MESSAGE_H
 
 #include <QString>
+#include <QStringRef>
+#include <QMetaType>
 
+/* group and sender are interned ids, the text and attachment share one buffer the getters return slices of.
+ * the time shown is derived from the server stamp, only messages stored before it was kept keep their time text */
 class Message
 {
 public:
     Message() = default;
-    Message(const QString& groupName, const QString& sender, const QString& message, const QString& time);
+    Message(const QString& groupName, const QString& sender, const QString& message, const QString& time,
+            qint64 id = 0, qint64 timestamp = 0);
     [[nodiscard]] const QString& getGroupName() const;
     [[nodiscard]] const QString& getSender() const;
-    [[nodiscard]] const QString& getMessage() const;
-    [[nodiscard]] const QString& getTime() const;
+    /* valid while the message lives, toString() where a QString is needed */
+    [[nodiscard]] QStringRef getMessage() const;
+    /* "hh:mm" of the stamp in local time, the stored text for unstamped messages */
+    [[nodiscard]] QString getTime() const;
+    [[nodiscard]] qint64 getId() const;
+    void setId(qint64 id);
+    /* ms since epoch stamped by the server, 0 for messages stored before it did */
+    [[nodiscard]] qint64 getTimestamp() const;
+    /* hex sha-256 of the attached file, the message text is its name, empty for plain messages */
+    [[nodiscard]] QStringRef getAttachment() const;
+    [[nodiscard]] qint64 getAttachmentSize() const;
+    void setAttachment(const QString& hash, qint64 size);
 
 private:
-    QString groupName;
-    QString sender;
-    QString message;
-    QString time;
+    QString text; // the message, the time of an unstamped message and the attachment hash one after another
+    qint64 id             = 0;
+    qint64 timestamp      = 0;
+    qint64 attachmentSize = 0;
+    quint32 groupId       = 0;
+    quint32 senderId      = 0;
+    int messageSize       = 0;
+    int timeSize          = 0;
 };
 
+Q_DECLARE_TYPEINFO(Message, Q_MOVABLE_TYPE);
+Q_DECLARE_METATYPE(Message)
+
 #endif // MESSENGER_MESSAGE_H
@@ -0,0 +1,49 @@
+#include <QtAlgorithms>
+#include "stringinterner.h"
+
+namespace {
+    int blockOf(const quint32 id)
+    {
+        return 31 - static_cast<int>(qCountLeadingZeroBits(id));
+    }
+} // namespace
+
+quint32 StringInterner::intern(const QString& string)
+{
+    if (string.isEmpty()) {
+        return 0;
+    }
+    lock.lockForRead();
+    quint32 id = ids.value(string);
+    lock.unlock();
+    if (id != 0) {
+        return id;
+    }
+
+    QWriteLocker locker(&lock);
+    // another thread may have added it between the two locks
+    id = ids.value(string);
+    if (id != 0) {
+        return id;
+    }
+    id              = nextId++;
+    const int block = blockOf(id);
+    if (blocks[block].load(std::memory_order_relaxed) == nullptr) {
+        blocks[block].store(new QString[quint32(1) << block], std::memory_order_release);
+    }
+    QString& stored = blocks[block].load(std::memory_order_relaxed)[id - (quint32(1) << block)];
+    stored          = string;
+    stored.squeeze();
+    ids.insert(stored, id);
+    return id;
+}
+
+const QString& StringInterner::lookup(const quint32 id)
+{
+    static const QString empty;
+    if (id == 0) {
+        return empty;
+    }
+    const int block = blockOf(id);
+    return blocks[block].load(std::memory_order_acquire)[id - (quint32(1) << block)];
+}
@@ -0,0 +1,26 @@
+#ifndef MESSENGER_STRING_INTERNER_H
+#define MESSENGER_STRING_INTERNER_H
+
+#include <QHash>
+#include <QReadWriteLock>
+#include <QString>
+#include <atomic>
+
+/* process wide table of the group and user names every message repeats, a name keeps its id until the process
+ * ends. ids are looked up without a lock, block n of the table holds 2^n names and is never moved */
+class StringInterner
+{
+public:
+    /* 0 stands for the empty string */
+    static quint32 intern(const QString& string);
+    static const QString& lookup(quint32 id);
+
+private:
+    static constexpr int maxBlocks = 32;
+    static inline QReadWriteLock lock{};
+    static inline QHash<QString, quint32> ids{};
+    static inline std::atomic<QString*> blocks[maxBlocks]{};
+    static inline quint32 nextId = 1;
+};
+
+#endif // MESSENGER_STRING_INTERNER_H